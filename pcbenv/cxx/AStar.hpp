@@ -6,9 +6,13 @@
 #include "PCBoard.hpp"
 #include "NavGrid.hpp"
 #include "Path.hpp"
+#include "GlobalRouter.hpp"
+#include "Rasterizer.hpp"
+#include <optional>
 #include <queue>
+#include <unordered_set>
 
-// OPTIMIZATIONS TODO:
+// Jump point search (AStarCosts::JumpPoints):
 // "Online Graph Pruning for Pathfinding on Grid Maps", D. Harabor & A. Grastien, AAAI 2011
 // 1) Don't evaluate nodes that are more quickly reached from the parent.
 // 2) Keep moving in the same direction without expansion as long as we don't
@@ -18,6 +22,35 @@
 //    as successor to our original node.
 // 4) If we reach an obstacle going straight, we do nothing.
 // The paper proves that this strategy does not affect optimality.
+// We use the variant without corner cutting and only jump across cells of unit cost.
+// A jump also stops before anything that isn't plain (endpoints, cells with a cost != 1)
+// and where a via would not be dominated by a via at the jump's origin.
+// Such points are expanded normally.
+
+// Bidirectional search (AStarCosts::Bidirectional):
+// The reverse search expands from the target cells towards the source in a second workspace.
+// The cost of a move depends on the move before it (turn cost, via discount), which the reverse
+// search does not know yet when it reaches a node. Its scores therefore count the first move of
+// its path as if it continued straight (or stacked vias), which is its cheapest case, and we add
+// the difference (the join cost, never negative) when the searches meet.
+// The keys cannot tell us when to stop as the heuristic is not consistent and may be weighted.
+// Instead, any path that is not found yet must cross both open sets, so it costs at least the sum
+// of the smallest scores on either side, and we stop once the best path found is no more expensive.
+// Like the forward search, each cell only keeps the cheapest way to reach it, so a path that is
+// more expensive up to the meeting cell but turns less there is not considered.
+
+// Weighted and anytime search (AStarCosts::Epsilon, Anytime):
+// The open list keys use the heuristic multiplied by Epsilon, which finds a path costing at most Epsilon times
+// the optimum while expanding far fewer nodes. The anytime variant then repeats the search with the weight
+// halved towards 1 each time, only relaxing nodes that can still lead to a cheaper path than the best one,
+// until the weight reaches 1 or the deadline passes. The best path is restored into the workspace at the end.
+
+// Net tree search (AStarCosts::NetTree):
+// The search may also end on the tracks of other connections of the net that leave the target pin.
+// The heuristic is the smaller of the estimate to the target pin and to the nearest tree cell,
+// using an octile distance field per layer computed with a two-pass chamfer transform.
+// As connections go from pin to pin, the part of the tree track between the pin and the junction
+// is copied to the front of the new track.
 
 /// Whether we can route diagonally if the adjacent directions (U,L for UL etc.) are blocked.
 #define ASTAR_ALLOW_XOVER false
@@ -29,24 +62,135 @@
 class NavPointRef
 {
 public:
-    NavPointRef(NavPoint *nav, float v) : mPoint(nav), mKey(nav->getScore() + v) { }
+    NavPointRef(NavPoint *nav, float key) : mKey(key), mPoint(nav) { }
     NavPoint *getPoint() const { return mPoint; }
     NavPoint *operator->() const { return mPoint; }
+    float getKey() const { return mKey; }
     bool operator<(const NavPointRef &that) const { return mKey >= that.mKey; }
 private:
     float mKey;
     NavPoint *mPoint;
 };
 
+/// The default open list, which may return nodes that are no longer open (must be skipped).
+class AStarBinaryHeap
+{
+public:
+    AStarBinaryHeap(NavGrid&, AStarWorkspace&) { }
+    bool empty() const { return mHeap.empty(); }
+    void push(NavPoint *P, float key, bool queued) { mHeap.push(NavPointRef(P, key)); }
+    NavPoint *top() const { return mHeap.top().getPoint(); }
+    float topKey() const { return mHeap.top().getKey(); }
+    NavPoint *pop() { auto P = mHeap.top().getPoint(); mHeap.pop(); return P; }
+private:
+    std::priority_queue<NavPointRef> mHeap;
+};
+
+/// Open list as a 4-ary min-heap of grid indices that changes the keys of nodes in place.
+/// The heap position of each node is stored in the workspace, it is only valid while the node is open.
+/// Keys can increase as well because the heuristic depends on the back direction.
+class AStarIndexedHeap
+{
+    struct Entry
+    {
+        float Key;
+        uint32_t Index;
+    };
+public:
+    AStarIndexedHeap(NavGrid &nav, AStarWorkspace &ws) : mBase(&nav.getPoint(0)), mWS(ws) { }
+    bool empty() const { return mHeap.empty(); }
+    void push(NavPoint *P, float key, bool queued);
+    NavPoint *pop();
+    NavPoint *top() const { return mBase + mHeap[0].Index; }
+    float topKey() const { return mHeap[0].Key; }
+private:
+    NavPoint *const mBase;
+    AStarWorkspace &mWS;
+    std::vector<Entry> mHeap;
+    void place(uint i, const Entry &e) { mHeap[i] = e; mWS[mBase[e.Index]].HeapPos = i; }
+    void siftUp(uint i);
+    void siftDown(uint i);
+};
+
+inline void AStarIndexedHeap::push(NavPoint *P, float key, bool queued)
+{
+    if (queued) {
+        const uint i = mWS[*P].HeapPos;
+        assert(mHeap[i].Index == uint32_t(P - mBase));
+        const bool up = key < mHeap[i].Key;
+        mHeap[i].Key = key;
+        if (up)
+            siftUp(i);
+        else
+            siftDown(i);
+    } else {
+        mHeap.push_back(Entry{key, uint32_t(P - mBase)});
+        siftUp(mHeap.size() - 1);
+    }
+}
+inline NavPoint *AStarIndexedHeap::pop()
+{
+    assert(!mHeap.empty());
+    const auto top = mHeap[0].Index;
+    if (mHeap.size() > 1) {
+        mHeap[0] = mHeap.back();
+        mHeap.pop_back();
+        siftDown(0);
+    } else {
+        mHeap.pop_back();
+    }
+    return mBase + top;
+}
+inline void AStarIndexedHeap::siftUp(uint i)
+{
+    const Entry e = mHeap[i];
+    while (i) {
+        const uint p = (i - 1) / 4;
+        if (!(e.Key < mHeap[p].Key))
+            break;
+        place(i, mHeap[p]);
+        i = p;
+    }
+    place(i, e);
+}
+inline void AStarIndexedHeap::siftDown(uint i)
+{
+    const Entry e = mHeap[i];
+    const uint n = mHeap.size();
+    while (true) {
+        const uint c0 = i * 4 + 1;
+        if (c0 >= n)
+            break;
+        uint m = c0;
+        for (uint c = c0 + 1; c < std::min(c0 + 4, n); ++c)
+            if (mHeap[c].Key < mHeap[m].Key)
+                m = c;
+        if (!(mHeap[m].Key < e.Key))
+            break;
+        place(i, mHeap[m]);
+        i = m;
+    }
+    place(i, e);
+}
+
+/// The cells on the adjacent layers that can be reached at no higher cost by placing a via
+/// at the origin of a jump and then following the jump there.
+/// A via at a cell along a jump is dominated by this path if the mirror cell is still set.
+struct AStarJumpMirrors
+{
+    NavPoint *P[2];
+};
+
 class AStar
 {
 public:
-    AStar(NavGrid&, const AStarCosts&);
+    AStar(NavGrid&, const AStarCosts&, AStarWorkspace&);
     ~AStar();
     bool search(Connection&);
     const std::vector<Point_25>& violations() const { return mViolationLocs; }
 private:
     NavGrid &mNav;
+    AStarWorkspace &mWS;
     Point_2 mTargetXY;
     int mTargetZ[2];
     std::vector<uint8_t> mPreferredDirections;
@@ -55,29 +199,92 @@ private:
     float mWrongDirectionCostDiag;
     float mViolationCost;
     uint32_t mLayerMask;
+    bool mJumpPoints{false};
+    const GlobalRouter *mCorridor{0};
+    IBox_3 mExplored; //!< bounding box of the expanded nodes
+    std::vector<std::pair<const Track *, bool>> mTree; //!< tracks of the net leaving the target pin and whether they start there
+    std::vector<uint32_t> mTreeCells; //!< grid indices of the cells on the center lines of mTree
+    std::vector<float> mTreeDistance; //!< distance in cells to the nearest tree cell on the same layer (for each cell of the window)
+    IBox_3 mTreeBox;
+    bool mTreeActive{false};
+    float mEpsilon{1.0f};
+    float mUpperBound{std::numeric_limits<float>::infinity()}; //!< cost of the best path found so far by the anytime search
+    float mPathCost; //!< cost of the path found by the last search
+    uint64_t mNumVisits{0};
     NavPoint *mTarget{0};
     Point_2 mSourceXY;
+    int mSourceZ[2];
     std::vector<Point_25> mViolationLocs;
     AStarCosts mCostParams;
-    float heuristic(const NavPoint&);
+    /// The endpoint columns get the SOURCE/TARGET flags and have blockages removed.
+    /// We apply this when reading flags instead of writing it to the grid.
+    /// The target comes first because it takes precedence.
+    struct EndPoint
+    {
+        int x, y, z0, z1;
+        uint32_t XY; //!< NavPoint::xy() of the column, ~0 if unset
+        uint16_t Set;
+        uint16_t Clear;
+    } mEnds[2];
+    float heuristic(const NavPoint&, GridDirection back) const;
+    float heuristicReverse(const NavPoint&, GridDirection back) const;
+    float estimate(const NavPoint&, GridDirection back, const Point_2 &xy, const int Z[2]) const;
+    float estimateVias(const NavPoint&, GridDirection back, int z0, int z1) const;
+    float estimateTree(const NavPoint&, GridDirection back) const;
+    void initTree(const Connection&);
+    void initTreeDistance(const IBox_3 &window);
+    uint treeIndex(const NavPoint &P) const { return ((P.z() - mTreeBox.min.z) * mTreeBox.h() + (P.y() - mTreeBox.min.y)) * mTreeBox.w() + (P.x() - mTreeBox.min.x); }
+    bool isTreeTarget(const NavPoint *P) const { return mTreeActive && mTreeDistance[treeIndex(*P)] == 0.0f; }
+    bool isTarget(const NavPoint *P) const { return (getFlags(P) & NAV_POINT_FLAG_TARGET) || isTreeTarget(P); }
+    bool joinTree(Path&, const NavPoint &junction) const;
     int getApproxBlockageSearchArea(const Pin *) const;
+    void explore(const NavPoint *);
+    void saveExplored(const IBox_3 &window);
+    IBox_3 getWindow(const Connection&, int margin) const;
     int _search(NavPoint *source, int maxVisits);
+    void improve(NavPoint *source, NavPoint *target);
+    bool expired(int visits) const;
     int _search(NavPoint *source, NavPoint *target, int maxVisits);
-    void initEndPoint(const Point_2&, int z[2], bool dst, bool save);
-    void finiEndPoint(const Point_2&, int z[2]);
+    template<class OpenList> int _search(NavPoint *source, int maxVisits);
+    template<class OpenList> int _searchBidirectional(NavPoint *source, int maxVisits);
+    bool spliceReverse(NavPoint *meet, const AStarWorkspace&);
+    void setEndPoint(const NavPoint&, int z[2], bool dst);
     bool reconstruct(Connection&);
     void addViolation(const NavPoint *, Real radius);
     void initCosts(const Connection&);
     float sumCostsSquare(const NavPoint *, int extent) const;
-    float computeCost(NavPoint *src, NavPoint *dst, const GridDirection d);
+    float computeCost(const NavPoint *dst, const GridDirection d, const GridDirection srcBack) const;
+    float turnCost(const GridDirection d, const GridDirection srcBack) const;
+    float joinCost(const NavPoint *dst, const GridDirection d, const GridDirection srcBack) const;
+    float layerCost(uint z) const { return (mLayerMask & (1 << z)) ? 1.0f : mCostParams.MaskedLayer; }
+    template<class OpenList> bool relax(NavPoint *, const GridDirection d, float score, uint seq, OpenList&);
+    template<class OpenList> bool relaxReverse(AStarWorkspace&, NavPoint *, const GridDirection d, float score, uint seq, OpenList&);
 private:
-    void writePoint(const Point_25&, uint16_t add, uint16_t clr, bool save);
+    uint16_t getFlags(const NavPoint *) const;
+    bool canPlaceVia(const NavPoint *P) const { return !(getFlags(P) & NAV_POINT_FLAGS_VIAS_BLOCKED); }
+    bool canAddVia(const NavPoint *, const NavPoint *) const;
     NavPoint *checkHEdge(const NavPoint *, GridDirection) const;
     NavPoint *checkVEdge(const NavPoint *, GridDirection) const;
+    NavPoint *checkHMove(const NavPoint *, GridDirection) const;
+    void getEdges(NavPoint *edges[GridDirection::Count], const NavPoint *, GridDirection backd) const;
+private:
+    bool isPlain(const NavPoint *P) const { return P->getCost() == 1.0f && !(getFlags(P) & NAV_POINT_FLAGS_ENDPOINT) && !isTreeTarget(P); }
+    bool isPlainAround(const NavPoint *, GridDirection, uint n) const;
+    bool isJumpOrigin(const NavPoint *) const;
+    uint8_t getJumpDirections(const NavPoint *) const;
+    AStarJumpMirrors getJumpMirrors(NavPoint *) const;
+    bool stepJumpMirrors(AStarJumpMirrors&, const NavPoint *, GridDirection) const;
+    NavPoint *jumpStraight(NavPoint *, GridDirection, uint &k, AStarJumpMirrors) const;
+    NavPoint *jumpDiagonal(NavPoint *, GridDirection, uint &k, AStarJumpMirrors) const;
+    float jumpCost(const NavPoint *src, const NavPoint *dst, GridDirection, uint k) const;
+    template<class OpenList> void labelJump(NavPoint *src, GridDirection, uint k, uint seq, OpenList&);
+    template<class OpenList> void expandJumpPoints(NavPoint *, uint seq, OpenList&);
 };
 
-AStar::AStar(NavGrid &nav, const AStarCosts &costs) : mNav(nav), mCostParams(costs)
+AStar::AStar(NavGrid &nav, const AStarCosts &costs, AStarWorkspace &ws) : mNav(nav), mWS(ws), mCostParams(costs)
 {
+    mEnds[0].x = mEnds[1].x = -1;
+    mEnds[0].XY = mEnds[1].XY = ~0u;
 }
 AStar::~AStar()
 {
@@ -92,53 +299,208 @@ inline float AStar::sumCostsSquare(const NavPoint *src, int ex) const
     return c;
 }
 
-inline void AStar::writePoint(const Point_25 &v, uint16_t add, uint16_t clr, bool save)
+/**
+ * Set up the flags for the source/target pin area and initialize mTargetZ/mSourceZ.
+ */
+inline void AStar::setEndPoint(const NavPoint &P, int Z[2], bool dst)
+{
+    auto &E = mEnds[dst ? 0 : 1];
+    E.x = P.x();
+    E.y = P.y();
+    E.XY = P.xy();
+    E.z0 = Z[0];
+    E.z1 = Z[1];
+    E.Set = dst ? NAV_POINT_FLAG_TARGET : NAV_POINT_FLAG_SOURCE;
+    // If the endpoint goes across multiple layers it will be a pin where we can move freely vertically, so remove via clearance. Leaving the pin is still blocked by the canPlaceVia() check.
+    E.Clear = NAV_POINT_FLAG_BLOCKED_TEMPORARY | NAV_POINT_FLAGS_ENDPOINT | ((Z[0] == Z[1]) ? NAV_POINT_FLAGS_TRACK_CLEARANCE : NAV_POINT_FLAGS_CLEARANCE);
+    auto &endZ = dst ? mTargetZ : mSourceZ;
+    endZ[0] = Z[0];
+    endZ[1] = Z[1];
+}
+/**
+ * The grid point's flags as seen by this search.
+ * Most points are not in an endpoint column, which takes one integer compare per endpoint to rule out.
+ */
+inline uint16_t AStar::getFlags(const NavPoint *P) const
+{
+    const uint16_t f = P->getFlags();
+    const uint32_t xy = P->xy();
+    if (xy != mEnds[0].XY && xy != mEnds[1].XY)
+        return f;
+    for (const auto &E : mEnds)
+        if (xy == E.XY && P->z() >= E.z0 && P->z() <= E.z1)
+            return (f & ~E.Clear) | E.Set;
+    return f;
+}
+inline bool AStar::canAddVia(const NavPoint *A, const NavPoint *B) const
+{
+    const auto a = getFlags(A);
+    const auto b = getFlags(B);
+    return !((a | b) & NAV_POINT_FLAGS_VIAS_BLOCKED) && !((a ^ b) & NAV_POINT_FLAG_INSIDE_PIN);
+}
+
+inline float AStar::heuristic(const NavPoint &A, GridDirection back) const
+{
+    const float h = estimate(A, back, mTargetXY, mTargetZ);
+    return mTreeActive ? std::min(h, estimateTree(A, back)) : h;
+}
+inline float AStar::heuristicReverse(const NavPoint &A, GridDirection back) const
+{
+    return estimate(A, back, mSourceXY, mSourceZ);
+}
+float AStar::estimate(const NavPoint &A, GridDirection back, const Point_2 &xy, const int Z[2]) const
+{
+    //float d = std::sqrt(CGAL::squared_distance(A.getRefPoint(), xy));
+    return geo::distance45(A.getRefPoint(&mNav), xy) + estimateVias(A, back, Z[0], Z[1]);
+}
+inline float AStar::estimateVias(const NavPoint &A, GridDirection back, int z0, int z1) const
 {
-    NavPoint *x = mNav.getPoint(v);
-    if (save)
-        x->saveFlags();
-    x->setFlags(add);
-    x->clearFlags(clr);
+    uint dz = 0;
+    if (A.getLayer() < z0)
+        dz = z0 - A.getLayer();
+    else if (A.getLayer() > z1)
+        dz = A.getLayer() - z1;
+    if (!dz)
+        return 0.0f;
+    if (!back.isVertical())
+        dz += 1;
+    return mViaCost * 0.5f * dz;
+}
+float AStar::estimateTree(const NavPoint &A, GridDirection back) const
+{
+    float h = std::numeric_limits<float>::infinity();
+    const uint n = mTreeBox.w() * mTreeBox.h();
+    const uint i = treeIndex(A) - (A.z() - mTreeBox.min.z) * n;
+    for (int z = mTreeBox.min.z; z <= mTreeBox.max.z; ++z) {
+        const float d = mTreeDistance[(z - mTreeBox.min.z) * n + i];
+        if (!std::isinf(d))
+            h = std::min(h, d * float(mNav.EdgeLen) + estimateVias(A, back, z, z));
+    }
+    return h;
 }
 
 /**
- * Mark the source/target pin area with flags and initialize mTargetZ.
+ * Collect the routed connections of the net that share the target pin (the connection's source) and the cells they cover.
+ * Their tracks are lifted from the grid by PCBoard::initPathfindingFor(), so the search can reach them.
  */
-inline void AStar::initEndPoint(const Point_2 &v, int Z[2], bool dst, bool save)
+void AStar::initTree(const Connection &X)
 {
-    const uint w = dst ? NAV_POINT_FLAG_TARGET : NAV_POINT_FLAG_SOURCE;
-    const uint m = dst ? NAV_POINT_FLAG_SOURCE : NAV_POINT_FLAG_TARGET;
-    // If the endpoint goes across multiple layers it will be a pin where we can move freely vertically, so remove via clearance. Leaving the pin is still blocked by the canPlaceVia() check.
-    const uint u = (Z[0] == Z[1]) ? NAV_POINT_FLAGS_TRACK_CLEARANCE : NAV_POINT_FLAGS_CLEARANCE;
-    for (int z = Z[0]; z <= Z[1]; ++z)
-        writePoint(Point_25(v, z), w, NAV_POINT_FLAG_BLOCKED_TEMPORARY | u | m, save);
-    if (dst) {
-        mTargetZ[0] = Z[0];
-        mTargetZ[1] = Z[1];
+    mTree.clear();
+    mTreeCells.clear();
+    const Pin *T = X.sourcePin();
+    if (!T)
+        return;
+    Rasterizer<RecordRangesROP> R(mNav);
+    for (const auto Y : T->connections()) {
+        if (Y == &X || !Y->isRouted() || !Y->hasTracks())
+            continue;
+        const auto &track = Y->getTrack(0);
+        mTree.emplace_back(&track, Y->sourcePin() == T);
+        for (const auto &s : track.getSegments())
+            R.rasterizeLine(s.base());
+        for (const auto &v : track.getVias())
+            R.rasterizeLine(Bbox_2(v.location().x(), v.location().y(), v.location().x(), v.location().y()), v.zmin(), v.zmax());
     }
+    for (const auto &r : R.OP.getRanges())
+        for (uint z = r.Z0; z <= r.Z1; ++z)
+        for (uint y = r.Y0; y <= r.Y1; ++y)
+        for (uint x = r.X0; x <= r.X1; ++x)
+            mTreeCells.push_back(&mNav.getPoint(x, y, z) - &mNav.getPoint(0));
+    DEBUG("A* net tree has " << mTree.size() << " tracks on " << mTreeCells.size() << " cells");
 }
-inline void AStar::finiEndPoint(const Point_2 &v, int Z[2])
+/**
+ * Compute the octile distance from each cell of the window to the nearest tree cell on its layer (ignoring obstacles).
+ */
+void AStar::initTreeDistance(const IBox_3 &box)
 {
-    for (int z = Z[0]; z <= Z[1]; ++z)
-        mNav.getPoint(v, z)->restoreFlags();
+    const float inf = std::numeric_limits<float>::infinity();
+    const float d1 = 1.0f;
+    const float d2 = std::sqrt(2.0f);
+    mTreeBox = box;
+    mTreeDistance.assign(box.volume(), inf);
+    uint count = 0;
+    for (auto i : mTreeCells) {
+        const auto &P = mNav.getPoint(i);
+        if (mWS.contains(P)) {
+            mTreeDistance[treeIndex(P)] = 0.0f;
+            count++;
+        }
+    }
+    mTreeActive = count > 0;
+    if (!mTreeActive)
+        return;
+    const int w = box.w();
+    const int h = box.h();
+    for (uint k = 0; k < box.d(); ++k) {
+        float *D = &mTreeDistance[k * w * h];
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                float &d = D[y * w + x];
+                if (x > 0)
+                    d = std::min(d, D[y * w + x - 1] + d1);
+                if (y > 0) {
+                    d = std::min(d, D[(y - 1) * w + x] + d1);
+                    if (x > 0)
+                        d = std::min(d, D[(y - 1) * w + x - 1] + d2);
+                    if (x < w - 1)
+                        d = std::min(d, D[(y - 1) * w + x + 1] + d2);
+                }
+            }
+        }
+        for (int y = h - 1; y >= 0; --y) {
+            for (int x = w - 1; x >= 0; --x) {
+                float &d = D[y * w + x];
+                if (x < w - 1)
+                    d = std::min(d, D[y * w + x + 1] + d1);
+                if (y < h - 1) {
+                    d = std::min(d, D[(y + 1) * w + x] + d1);
+                    if (x < w - 1)
+                        d = std::min(d, D[(y + 1) * w + x + 1] + d2);
+                    if (x > 0)
+                        d = std::min(d, D[(y + 1) * w + x - 1] + d2);
+                }
+            }
+        }
+    }
 }
 
-float AStar::heuristic(const NavPoint &A)
+/**
+ * Get the path along the tree track that comes closest to the junction, from the target pin to the junction.
+ */
+bool AStar::joinTree(Path &path, const NavPoint &J) const
 {
-    //float d = std::sqrt(CGAL::squared_distance(A.getRefPoint(), mTargetXY));
-    float d = geo::distance45(A.getRefPoint(&mNav), mTargetXY);
-
-    uint dz = 0;
-    if (A.getLayer() < mTargetZ[0])
-        dz = mTargetZ[0] - A.getLayer();
-    else if (A.getLayer() > mTargetZ[1])
-        dz = A.getLayer() - mTargetZ[1];
-    if (dz) {
-        if (!A.getBackDirection().isVertical())
-            dz += 1;
-        d += mViaCost * 0.5f * dz;
+    const auto v = J.getRefPoint25(&mNav);
+    Real best = std::numeric_limits<Real>::infinity();
+    for (const auto &[track, forward] : mTree) {
+        Path P;
+        track->getPath(P);
+        if (!forward)
+            P.reverse();
+        for (uint k = 1; k < P.numPoints(); ++k) {
+            const auto &a = P.getPoint(k - 1);
+            const auto &b = P.getPoint(k);
+            Point_2 q = a.xy();
+            if (P.isPlanarAt(k)) {
+                if (a.z() != v.z())
+                    continue;
+                const Vector_2 ab = b.xy() - a.xy();
+                if (ab.squared_length() > 0.0)
+                    q = a.xy() + ab * std::clamp((v.xy() - a.xy()) * ab / ab.squared_length(), Real(0), Real(1));
+            } else if (v.z() < std::min(a.z(), b.z()) || v.z() > std::max(a.z(), b.z())) {
+                continue;
+            }
+            const Real d2 = CGAL::squared_distance(q, v.xy());
+            if (d2 >= best)
+                continue;
+            best = d2;
+            path.clear();
+            for (uint i = 0; i < k; ++i)
+                path._add(P.getPoint(i));
+            path.add(Point_25(q, v.z()));
+            path.add(v);
+        }
     }
-    return d;
+    return !path.empty();
 }
 
 // When we add a via:
@@ -153,28 +515,47 @@ bool AStar::reconstruct(Connection &route)
     assert(!route.hasTracks() && !route.isRouted());
     assert(mTarget);
     const NavPoint *head = mTarget;
-    for (auto next = head->getBackEdge(mNav); next->hasFlags(NAV_POINT_FLAG_TARGET); next = next->getBackEdge(mNav))
+    for (auto next = head->getEdge(mNav, mWS[*head].BackDir); isTarget(next); next = next->getEdge(mNav, mWS[*next].BackDir))
         head = next;
+    const bool junction = !(getFlags(head) & NAV_POINT_FLAG_TARGET);
+    const NavPoint *J = head;
     Track *T = route.newTrack(head->getRefPoint25(&mNav));
     const NavPoint *node = head;
     DEBUG("AStar " << node->str(&mNav));
-    GridDirection d = node->getBackDirection();
-    while (!node->hasFlags(NAV_POINT_FLAG_SOURCE)) {
-        node = node->getBackEdge(mNav);
-        if (!node->canRoute())
+    auto &path = mWS.getResult().Path;
+    path.push_back(node - &mNav.getPoint(0));
+    GridDirection d = mWS[*node].BackDir;
+    while (!(getFlags(node) & NAV_POINT_FLAG_SOURCE)) {
+        node = node->getEdge(mNav, mWS[*node].BackDir);
+        path.push_back(node - &mNav.getPoint(0));
+        if (getFlags(node) & NAV_POINT_FLAGS_TRACKS_BLOCKED)
             addViolation(node, T->defaultWidth());
         DEBUG("AStar " << node->str(&mNav));
-        if (node->getBackDirection() == d && node->getLayer() == head->getLayer() && !node->hasFlags(NAV_POINT_FLAG_SOURCE))
+        if (mWS[*node].BackDir == d && node->getLayer() == head->getLayer() && !(getFlags(node) & NAV_POINT_FLAG_SOURCE))
             continue;
         if (!d.isVertical())
             T->_append(head->getSegmentTo(*node, &mNav));
         head = node;
-        d = node->getBackDirection();
+        d = mWS[*node].BackDir;
     }
     assert(head == node);
     T->_setEnd(node->getRefPoint25(&mNav));
-    route.forceRouted();
-    T->autocreateVias(T->end() == node->getRefPoint25(&mNav) ? T->end() : route.target());
+    if (junction) {
+        Path path;
+        if (!joinTree(path, *J))
+            throw std::runtime_error("A* path ends on a cell that is not on the net's tracks");
+        Path branch;
+        T->getPath(branch);
+        if (branch.numPoints() > 1)
+            path.append(branch);
+        route.clearTracks();
+        T = route.newTrack(path.front());
+        T->setPath(path);
+        route.forceRouted();
+    } else {
+        route.forceRouted();
+        T->autocreateVias(T->end() == node->getRefPoint25(&mNav) ? T->end() : route.target());
+    }
     T->computeLength();
     return true;
 }
@@ -191,6 +572,48 @@ void AStar::addViolation(const NavPoint *node, Real radius)
         mViolationLocs.push_back(v);
 }
 
+/**
+ * The search window: the bounding box around the connection's components expanded by margin cells on all layers.
+ * Returns the whole grid if margin < 0.
+ */
+IBox_3 AStar::getWindow(const Connection &X, int margin) const
+{
+    const IPoint_3 last(mNav.getSize(0) - 1, mNav.getSize(1) - 1, mNav.getSize(2) - 1);
+    if (margin < 0)
+        return IBox_3(IPoint_3(0, 0, 0), last);
+    auto box = mNav.getBox(X.bboxAroundComps());
+    box.min.x = std::max(box.min.x - margin, 0);
+    box.min.y = std::max(box.min.y - margin, 0);
+    box.max.x = std::min(box.max.x + margin, last.x);
+    box.max.y = std::min(box.max.y + margin, last.y);
+    return box;
+}
+
+inline void AStar::explore(const NavPoint *P)
+{
+    mNumVisits++;
+    mExplored.min = mExplored.min.min(IPoint_3(P->x(), P->y(), P->z()));
+    mExplored.max = mExplored.max.max(IPoint_3(P->x(), P->y(), P->z()));
+}
+/**
+ * Store the region that the search result depends on in the workspace.
+ * Expansion also reads the neighbours of expanded nodes, jumps and the global router read anything inside the window.
+ */
+void AStar::saveExplored(const IBox_3 &window)
+{
+    auto &box = mWS.getResult().Explored;
+    if (mJumpPoints || mCorridor) {
+        mExplored.min = mExplored.min.min(window.min);
+        mExplored.max = mExplored.max.max(window.max);
+    }
+    if (!mExplored.valid()) {
+        box = mExplored;
+        return;
+    }
+    box.min = (mExplored.min - IVector_3(1, 1, 1)).max(window.min);
+    box.max = (mExplored.max + IVector_3(1, 1, 1)).min(window.max);
+}
+
 /**
  * Return the number of grid cells to scan to check for a blocked pin.
  */
@@ -205,7 +628,15 @@ int AStar::getApproxBlockageSearchArea(const Pin *T) const
     return std::max(384, std::min(nA * 8, 1024));
 }
 
-inline float AStar::computeCost(NavPoint *src, NavPoint *dst, const GridDirection d)
+inline float AStar::turnCost(const GridDirection d, const GridDirection srcBack) const
+{
+    return mCostParams.TurnPer45Degrees * math::squared(d.opposite().get45DegreeStepsBetween(srcBack));
+}
+
+/**
+ * The cost of moving into dst in direction d from a node that was reached from direction srcBack.
+ */
+inline float AStar::computeCost(const NavPoint *dst, const GridDirection d, const GridDirection srcBack) const
 {
     auto moveCost = dst->getCost();
 
@@ -213,7 +644,7 @@ inline float AStar::computeCost(NavPoint *src, NavPoint *dst, const GridDirectio
         // moveCost = sumCostsSquare(dst, 1);
         moveCost *= mViaCost;
         // Using the same via costs less, but we can't make the cost 0 or we'd always explore the whole layer stack rather:
-        if (src->getBackDirection().isVertical())
+        if (srcBack.isVertical())
             moveCost *= 0.5f;
     } else {
         const bool nonPref = !(mPreferredDirections[dst->getLayer()] & d.mask());
@@ -223,27 +654,295 @@ inline float AStar::computeCost(NavPoint *src, NavPoint *dst, const GridDirectio
             moveCost *= mCostParams.WrongDirection;
         if (!(mLayerMask & (1 << dst->getLayer())))
             moveCost *= mCostParams.MaskedLayer;
-        if (dst->hasFlags(NAV_POINT_FLAG_ROUTE_TRACK_CLEARANCE))
+        if (getFlags(dst) & NAV_POINT_FLAG_ROUTE_TRACK_CLEARANCE)
             moveCost *= mViolationCost;
-        moveCost += mCostParams.TurnPer45Degrees * math::squared(d.opposite().get45DegreeStepsBetween(src->getBackDirection()));
+        moveCost += turnCost(d, srcBack);
     }
     // Moving through the source node is cheaper:
-    if (dst->hasFlags(NAV_POINT_FLAG_SOURCE))
+    if (getFlags(dst) & NAV_POINT_FLAG_SOURCE)
         moveCost *= 0.125f;
     return moveCost;
 }
 
+/**
+ * The part of computeCost that depends on the direction srcBack (turn cost and via discount).
+ * It is relative to moving straight on (srcBack == d.opposite()), which is the cheapest case, so it is never negative.
+ */
+inline float AStar::joinCost(const NavPoint *dst, const GridDirection d, const GridDirection srcBack) const
+{
+    return computeCost(dst, d, srcBack) - computeCost(dst, d, d.opposite());
+}
+
 inline NavPoint *AStar::checkHEdge(const NavPoint *ref, GridDirection d) const
 {
     auto e = ref->getEdge(mNav, d);
-    return (e && !e->hasFlags(mRouteMask)) ? e : 0;
+    return (e && mWS.contains(*e) && (!mCorridor || mCorridor->contains(*e)) && !(getFlags(e) & mRouteMask)) ? e : 0;
 }
 inline NavPoint *AStar::checkVEdge(const NavPoint *ref, GridDirection d) const
 {
-    if (!ref->canPlaceVia())
-        return 0;
     auto e = ref->getEdge(mNav, d);
-    return (e && ref->canAddVia(*e)) ? e : 0;
+    return (e && mWS.contains(*e) && (!mCorridor || mCorridor->contains(*e)) && canAddVia(ref, e)) ? e : 0;
+}
+/**
+ * Like checkHEdge but diagonal moves also require both adjacent straight moves to be free.
+ */
+inline NavPoint *AStar::checkHMove(const NavPoint *ref, GridDirection d) const
+{
+    if (d._isDiagonal() && !ASTAR_ALLOW_XOVER && !(checkHEdge(ref, d.rotatedCcw45()) && checkHEdge(ref, d.rotatedCw45())))
+        return 0;
+    return checkHEdge(ref, d);
+}
+
+/**
+ * Get the neighbours of P that can be moved to, except for those that are never better than going there from the previous node.
+ */
+inline void AStar::getEdges(NavPoint *edges[GridDirection::Count], const NavPoint *P, GridDirection backd) const
+{
+    // FIXME: The no-cross check is still no sufficient for correctness.
+    // We can have conditions where unroute-reroute does not work:
+    //   A B
+    //  A B
+    // A BCCC <-- C can be routed or be a via, but then B becomes illegal
+    //    CCC
+    //    CCC
+    edges[GridDirection::U().n()] = checkHEdge(P, GridDirection::U());
+    edges[GridDirection::D().n()] = checkHEdge(P, GridDirection::D());
+    edges[GridDirection::L().n()] = checkHEdge(P, GridDirection::L());
+    edges[GridDirection::R().n()] = checkHEdge(P, GridDirection::R());
+    edges[GridDirection::UR().n()] = ((edges[GridDirection::U().n()] && edges[GridDirection::R().n()]) || ASTAR_ALLOW_XOVER) ? checkHEdge(P, GridDirection::UR()) : 0;
+    edges[GridDirection::DR().n()] = ((edges[GridDirection::D().n()] && edges[GridDirection::R().n()]) || ASTAR_ALLOW_XOVER) ? checkHEdge(P, GridDirection::DR()) : 0;
+    edges[GridDirection::DL().n()] = ((edges[GridDirection::D().n()] && edges[GridDirection::L().n()]) || ASTAR_ALLOW_XOVER) ? checkHEdge(P, GridDirection::DL()) : 0;
+    edges[GridDirection::UL().n()] = ((edges[GridDirection::U().n()] && edges[GridDirection::L().n()]) || ASTAR_ALLOW_XOVER) ? checkHEdge(P, GridDirection::UL()) : 0;
+    edges[GridDirection::A().n()] = checkVEdge(P, GridDirection::A());
+    edges[GridDirection::V().n()] = checkVEdge(P, GridDirection::V());
+    if (!backd.isZero())
+        edges[backd.n()] = 0; // no need to check going right back
+    if (backd.is2D()) {
+        edges[backd.rotatedCcw45().n()] = 0; // these will never be better as edge costs are node costs and never negative
+        edges[backd.rotatedCw45().n()] = 0;
+    }
+}
+
+template<class OpenList> inline bool AStar::relax(NavPoint *node, const GridDirection d, float score, uint seq, OpenList &openList)
+{
+    auto &N = mWS[*node];
+    if (N.Visits.isSeen(seq) && score >= N.Score)
+        return false;
+    const float h = heuristic(*node, d.opposite());
+    if (score + h >= mUpperBound)
+        return false;
+    const bool queued = N.Visits.isOpen(seq);
+    N.BackDir = d.opposite();
+    N.Score = score;
+    N.Visits.setOpen(seq);
+    openList.push(node, score + mEpsilon * h, queued);
+    return true;
+}
+/**
+ * Like relax but for the reverse search, d is the direction of the move towards the target.
+ */
+template<class OpenList> inline bool AStar::relaxReverse(AStarWorkspace &ws, NavPoint *node, const GridDirection d, float score, uint seq, OpenList &openList)
+{
+    auto &N = ws[*node];
+    if (N.Visits.isSeen(seq) && score >= N.Score)
+        return false;
+    const bool queued = N.Visits.isOpen(seq);
+    N.BackDir = d;
+    N.Score = score;
+    N.Visits.setOpen(seq);
+    openList.push(node, score + mEpsilon * heuristicReverse(*node, N.BackDir), queued);
+    return true;
+}
+
+/**
+ * Check whether the accessible neighbours in directions d-n*45 to d+n*45 are plain.
+ */
+inline bool AStar::isPlainAround(const NavPoint *P, GridDirection d, uint n) const
+{
+    for (uint i = 0; i <= 2 * n; ++i) {
+        const auto e = checkHEdge(P, d.rotatedCw45(8 - n + i));
+        if (e && !isPlain(e))
+            return false;
+    }
+    return true;
+}
+/**
+ * We only prune and jump from plain points with plain neighbours, the others are expanded normally.
+ */
+inline bool AStar::isJumpOrigin(const NavPoint *P) const
+{
+    if (!isPlain(P))
+        return false;
+    for (auto d = GridDirection::begin(); d != GridDirection::hend(); ++d)
+        if (auto e = checkHEdge(P, d); e && !isPlain(e))
+            return false;
+    return true;
+}
+
+/**
+ * Returns the mask of directions to jump to from P as per the pruning rules without corner cutting.
+ */
+uint8_t AStar::getJumpDirections(const NavPoint *P) const
+{
+    const auto backd = mWS[*P].BackDir;
+    if (!backd.is2D())
+        return 0xff;
+    const auto t = backd.opposite();
+    uint8_t mask = 0;
+    if (t._isDiagonal()) {
+        const bool a = checkHEdge(P, t.rotatedCcw45());
+        const bool b = checkHEdge(P, t.rotatedCw45());
+        if (a)
+            mask |= t.rotatedCcw45().mask();
+        if (b)
+            mask |= t.rotatedCw45().mask();
+        if (a && b)
+            mask |= t.mask();
+    } else {
+        const bool a = checkHEdge(P, t.rotatedCcw45(2));
+        const bool b = checkHEdge(P, t.rotatedCw45(2));
+        if (checkHEdge(P, t)) {
+            mask |= t.mask();
+            if (a)
+                mask |= t.rotatedCcw45().mask();
+            if (b)
+                mask |= t.rotatedCw45().mask();
+        }
+        if (a)
+            mask |= t.rotatedCcw45(2).mask();
+        if (b)
+            mask |= t.rotatedCw45(2).mask();
+    }
+    return mask;
+}
+
+AStarJumpMirrors AStar::getJumpMirrors(NavPoint *P) const
+{
+    AStarJumpMirrors M;
+    for (uint i = 0; i < 2; ++i) {
+        const auto V = checkVEdge(P, GridDirection(GridDirection::FirstVertical + i));
+        M.P[i] = (V && isPlain(V) && layerCost(V->getLayer()) <= layerCost(P->getLayer())) ? V : 0;
+    }
+    return M;
+}
+/**
+ * Advance the mirror points along with a jump that arrived at P.
+ * @return Whether a via placed at P would not be dominated by the mirrors.
+ */
+inline bool AStar::stepJumpMirrors(AStarJumpMirrors &M, const NavPoint *P, GridDirection d) const
+{
+    bool forced = false;
+    for (uint i = 0; i < 2; ++i) {
+        if (M.P[i]) {
+            M.P[i] = checkHMove(M.P[i], d);
+            if (M.P[i] && !isPlain(M.P[i]))
+                M.P[i] = 0;
+        }
+        if (!M.P[i] && checkVEdge(P, GridDirection(GridDirection::FirstVertical + i)))
+            forced = true;
+    }
+    return forced;
+}
+
+/**
+ * Move from P in straight direction d until we reach a jump point (returned) or an obstacle (returns null).
+ * @param k Incremented by the number of steps taken.
+ */
+NavPoint *AStar::jumpStraight(NavPoint *P, GridDirection d, uint &k, AStarJumpMirrors M) const
+{
+    const auto s1 = d.rotatedCcw45(2);
+    const auto s2 = d.rotatedCw45(2);
+    while (true) {
+        auto N = checkHEdge(P, d);
+        if (!N)
+            return 0;
+        k += 1;
+        if (!isPlain(N) || !isPlainAround(N, d, 1))
+            return N;
+        if ((checkHEdge(N, s1) && !checkHEdge(P, s1)) ||
+            (checkHEdge(N, s2) && !checkHEdge(P, s2)))
+            return N;
+        if (stepJumpMirrors(M, N, d))
+            return N;
+        P = N;
+    }
+}
+/**
+ * Move from P in diagonal direction d until a straight jump from the current point finds a jump point.
+ */
+NavPoint *AStar::jumpDiagonal(NavPoint *P, GridDirection d, uint &k, AStarJumpMirrors M) const
+{
+    while (true) {
+        auto N = checkHMove(P, d);
+        if (!N)
+            return 0;
+        k += 1;
+        if (!isPlain(N) || !isPlainAround(N, d, 2))
+            return N;
+        if (stepJumpMirrors(M, N, d))
+            return N;
+        uint n = 0;
+        if (jumpStraight(N, d.rotatedCcw45(), n, M) || jumpStraight(N, d.rotatedCw45(), n, M))
+            return N;
+        P = N;
+    }
+}
+
+/**
+ * The cost of moving k steps from src to dst in direction d, with all cells in between being plain.
+ */
+inline float AStar::jumpCost(const NavPoint *src, const NavPoint *dst, GridDirection d, uint k) const
+{
+    const auto back = mWS[*src].BackDir;
+    if (k == 1)
+        return computeCost(dst, d, back);
+    const float unit = (d._isDiagonal() ? std::sqrt(2.0f) : 1.0f) * layerCost(src->getLayer());
+    return turnCost(d, back) + unit * (k - 1) + computeCost(dst, d, d.opposite());
+}
+/**
+ * Set the back directions and scores of the points skipped by a jump so we can reconstruct the path.
+ * Points that already have a better path are left alone, their path is just as good to get here.
+ */
+template<class OpenList> void AStar::labelJump(NavPoint *src, GridDirection d, uint k, uint seq, OpenList &openList)
+{
+    const float unit = (d._isDiagonal() ? std::sqrt(2.0f) : 1.0f) * layerCost(src->getLayer());
+    float score = mWS[*src].Score + turnCost(d, mWS[*src].BackDir);
+    for (uint i = 1; i < k; ++i) {
+        src = src->getEdge(mNav, d);
+        score += unit;
+        auto &N = mWS[*src];
+        if (N.Visits.isSeen(seq) && score >= N.Score)
+            continue;
+        if (N.Visits.isOpen(seq)) {
+            relax(src, d, score, seq, openList);
+            continue;
+        }
+        N.BackDir = d.opposite();
+        N.Score = score;
+        if (!N.Visits.isSeen(seq)) {
+            N.Visits.setOpen(seq);
+            N.Visits.setDone(seq);
+        }
+    }
+}
+template<class OpenList> void AStar::expandJumpPoints(NavPoint *current, uint seq, OpenList &openList)
+{
+    const auto dirs = getJumpDirections(current);
+    const auto M = getJumpMirrors(current);
+    const auto &C = mWS[*current];
+    for (auto d = GridDirection::begin(); d != GridDirection::hend(); ++d) {
+        if (!(dirs & d.mask()))
+            continue;
+        uint k = 0;
+        auto J = d._isDiagonal() ? jumpDiagonal(current, d, k, M) : jumpStraight(current, d, k, M);
+        if (J && relax(J, d, C.Score + jumpCost(current, J, d, k), seq, openList))
+            labelJump(current, d, k, seq, openList);
+    }
+    if (!canPlaceVia(current))
+        return;
+    for (auto d = GridDirection::hend(); d != GridDirection::vend(); ++d)
+        if (auto V = checkVEdge(current, d))
+            relax(V, d, C.Score + computeCost(V, d, C.BackDir), seq, openList);
 }
 
 #define PERF_COUNTER_T(i)    auto __t##i = std::chrono::high_resolution_clock::now()
@@ -270,26 +969,116 @@ bool AStar::search(Connection &route)
     sourceZ[1] = route.targetPin() ? route.targetPin()->maxLayer() : source->getLayer();
     targetZ[1] = route.sourcePin() ? route.sourcePin()->maxLayer() : target->getLayer();
 
-    // First test the other direction to see if we're blocked off close to the endpoint (rv < 0).
-    initEndPoint(target->getRefPoint(&mNav), targetZ, 0, true);
-    initEndPoint(source->getRefPoint(&mNav), sourceZ, 1, true);
-    auto rv = _search(target, source, getApproxBlockageSearchArea(route.sourcePin()));
-    if (rv >= 0) {
-        initEndPoint(source->getRefPoint(&mNav), sourceZ, 0, false);
-        initEndPoint(target->getRefPoint(&mNav), targetZ, 1, false);
-        rv = _search(source, target, std::numeric_limits<int>::max());
+    if (mCostParams.NetTree)
+        initTree(route);
+
+    auto run = [&](const IBox_3 &box) {
+        // First test the other direction to see if we're blocked off close to the endpoint (rv < 0).
+        // A bidirectional search finds out by itself as one of its open lists runs empty.
+        mTreeActive = false;
+        setEndPoint(*target, targetZ, false);
+        setEndPoint(*source, sourceZ, true);
+        auto rv = mCostParams.Bidirectional ? 0 : _search(target, source, getApproxBlockageSearchArea(route.sourcePin()));
+        if (rv >= 0) {
+            setEndPoint(*source, sourceZ, false);
+            setEndPoint(*target, targetZ, true);
+            if (!mTree.empty())
+                initTreeDistance(box);
+            rv = _search(source, target, std::numeric_limits<int>::max());
+        }
+        return rv;
+    };
+
+    auto &result = mWS.getResult();
+    result.reset();
+    mNumVisits = 0;
+    mExplored.min = IPoint_3(std::numeric_limits<int>::max(), std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
+    mExplored.max = IPoint_3(-1, -1, -1);
+
+    // If we don't find a path inside the window, double its margin until it covers the whole grid.
+    int rv;
+    std::optional<GlobalRouter> GR;
+    for (int margin = mCostParams.Window; true; margin = std::max(margin * 2, 1)) {
+        const auto box = getWindow(route, margin);
+        mWS.init(mNav, box);
+
+        // Restrict the search to the corridor around a coarse route first, and search the whole window if that fails.
+        GR.reset();
+        if (mCostParams.Corridor > 0) {
+            GR.emplace(mNav, mCostParams.Corridor);
+            GR->setCosts(mViaCost, mLayerMask, mCostParams.MaskedLayer);
+            if (GR->route(*source, sourceZ, *target, targetZ, box))
+                mCorridor = &*GR;
+            result.Corridor = mCorridor ? 1 : 0;
+        }
+        rv = run(box);
+        if (rv <= 0 && mCorridor) {
+            DEBUG("A* found no path inside the corridor");
+            saveExplored(box);
+            mCorridor = 0;
+            result.Corridor = 0;
+            rv = run(box);
+        }
+        if (rv > 0 && mCostParams.Anytime)
+            improve(source, target);
+        saveExplored(box);
+        mCorridor = 0;
+        if (rv > 0 || box.volume() == int64_t(mNav.getNumPoints()) || mCostParams.FixedWindow)
+            break;
+        DEBUG("A* found no path inside window " << box);
     }
     DEBUG("A* " << ((rv > 0) ? "finished" : "failed") << " after " << ((rv > 0) ? (std::numeric_limits<int>::max() - rv) : -rv) << " nodes.");
 
     auto ret = (rv > 0) && reconstruct(route);
+    result.Visits = mNumVisits;
+    if (ret) {
+        result.Cost = mPathCost;
+        if (result.Corridor > 0)
+            for (auto i : result.Path)
+                result.OutsideCorridor += !GR->contains(mNav.getPoint(i));
+    }
     if (rv <= 0) {
         std::lock_guard wlock(mNav.getPCB().getLock());
         route.clearTracks();
     }
-    finiEndPoint(source->getRefPoint(&mNav), sourceZ);
-    finiEndPoint(target->getRefPoint(&mNav), targetZ);
     return ret;
 }
+/**
+ * Search again with decreasing heuristic weights for a cheaper path than the one found.
+ * The search only relaxes nodes that could lead to a cheaper path, so it fails once there is none.
+ */
+void AStar::improve(NavPoint *source, NavPoint *target)
+{
+    std::vector<std::pair<NavPoint *, GridDirection>> best;
+    NavPoint *bestTarget = 0;
+    auto save = [&]() {
+        bestTarget = mTarget;
+        best.clear();
+        for (NavPoint *P = mTarget; P; P = mWS[*P].BackDir.isZero() ? 0 : P->getEdge(mNav, mWS[*P].BackDir))
+            best.emplace_back(P, mWS[*P].BackDir);
+        mUpperBound = mPathCost;
+        mWS.getResult().Costs.push_back(mPathCost);
+    };
+    save();
+    while (mEpsilon > 1.0f && std::chrono::system_clock::now() < mCostParams.Deadline) {
+        mEpsilon = (mEpsilon - 1.0f < 1.0f / 64.0f) ? 1.0f : (1.0f + (mEpsilon - 1.0f) * 0.5f);
+        DEBUG("A* anytime: cost " << mUpperBound << ", next weight " << mEpsilon);
+        if (_search(source, target, std::numeric_limits<int>::max()) > 0)
+            save();
+    }
+    mTarget = bestTarget;
+    for (const auto &[P, d] : best)
+        mWS[*P].BackDir = d;
+    mUpperBound = std::numeric_limits<float>::infinity();
+}
+/**
+ * Whether the anytime search ran out of time (only checked every 1024 nodes).
+ */
+inline bool AStar::expired(int visits) const
+{
+    return !(visits & 0x3ff) && !std::isinf(mUpperBound) && std::chrono::system_clock::now() >= mCostParams.Deadline;
+}
+
 int AStar::_search(NavPoint *source, NavPoint *target, int maxVisits)
 {
     assert(source && target && source != target);
@@ -299,64 +1088,50 @@ int AStar::_search(NavPoint *source, NavPoint *target, int maxVisits)
 }
 int AStar::_search(NavPoint *source, int maxVisits)
 {
-    const uint seq = mNav.nextSearchSeq();
+    if (mCostParams.Bidirectional)
+        return mCostParams.IndexedQueue ? _searchBidirectional<AStarIndexedHeap>(source, maxVisits) : _searchBidirectional<AStarBinaryHeap>(source, maxVisits);
+    if (mCostParams.IndexedQueue)
+        return _search<AStarIndexedHeap>(source, maxVisits);
+    return _search<AStarBinaryHeap>(source, maxVisits);
+}
+template<class OpenList> int AStar::_search(NavPoint *source, int maxVisits)
+{
+    const uint seq = mWS.nextSeq();
 
-    source->setScore(0);
-    source->setBackDirection(GridDirection::Z().n());
-    source->getVisits().setOpen(seq);
+    auto &S = mWS[*source];
+    S.Score = 0;
+    S.BackDir = GridDirection::Z();
+    S.Visits.setOpen(seq);
 
-    std::priority_queue<NavPointRef> openList;
-    openList.push(NavPointRef(source, heuristic(*source)));
+    OpenList openList(mNav, mWS);
+    openList.push(source, mEpsilon * heuristic(*source, S.BackDir), false);
     while (!openList.empty()) {
-        auto current = openList.top().getPoint();
-        openList.pop();
-        if (!current->getVisits().isOpen(seq)) // duplicate entry already encountered sooner
+        auto current = openList.pop();
+        auto &C = mWS[*current];
+        if (!C.Visits.isOpen(seq)) // duplicate entry already encountered sooner
             continue;
-        if (current->hasFlags(NAV_POINT_FLAG_TARGET)) {
+        explore(current);
+        if (isTarget(current)) {
             mTarget = current;
+            mPathCost = C.Score;
             return maxVisits;
         }
-        if (!--maxVisits)
+        if (!--maxVisits || expired(maxVisits))
             break;
-        current->getVisits().setDone(seq);
-
-        // FIXME: The no-cross check is still no sufficient for correctness.
-        // We can have conditions where unroute-reroute does not work:
-        //   A B
-        //  A B
-        // A BCCC <-- C can be routed or be a via, but then B becomes illegal
-        //    CCC
-        //    CCC
-        NavPoint *edges[GridDirection::Count];
-        edges[GridDirection::U().n()] = checkHEdge(current, GridDirection::U());
-        edges[GridDirection::D().n()] = checkHEdge(current, GridDirection::D());
-        edges[GridDirection::L().n()] = checkHEdge(current, GridDirection::L());
-        edges[GridDirection::R().n()] = checkHEdge(current, GridDirection::R());
-        edges[GridDirection::UR().n()] = ((edges[GridDirection::U().n()] && edges[GridDirection::R().n()]) || ASTAR_ALLOW_XOVER) ? checkHEdge(current, GridDirection::UR()) : 0;
-        edges[GridDirection::DR().n()] = ((edges[GridDirection::D().n()] && edges[GridDirection::R().n()]) || ASTAR_ALLOW_XOVER) ? checkHEdge(current, GridDirection::DR()) : 0;
-        edges[GridDirection::DL().n()] = ((edges[GridDirection::D().n()] && edges[GridDirection::L().n()]) || ASTAR_ALLOW_XOVER) ? checkHEdge(current, GridDirection::DL()) : 0;
-        edges[GridDirection::UL().n()] = ((edges[GridDirection::U().n()] && edges[GridDirection::L().n()]) || ASTAR_ALLOW_XOVER) ? checkHEdge(current, GridDirection::UL()) : 0;
-        edges[GridDirection::A().n()] = checkVEdge(current, GridDirection::A());
-        edges[GridDirection::V().n()] = checkVEdge(current, GridDirection::V());
-        const auto backd = current->getBackDirection();
-        if (!backd.isZero())
-            edges[backd.n()] = 0; // no need to check going right back
-        if (backd.is2D()) {
-            edges[backd.rotatedCcw45().n()] = 0; // these will never be better as edge costs are node costs and never negative
-            edges[backd.rotatedCw45().n()] = 0;
+        C.Visits.setDone(seq);
+
+        if (mJumpPoints && isJumpOrigin(current)) {
+            expandJumpPoints(current, seq, openList);
+            continue;
         }
 
-        for (auto d = GridDirection::begin(); d != (current->canPlaceVia() ? GridDirection::vend() : GridDirection::hend()); ++d) {
+        NavPoint *edges[GridDirection::Count];
+        getEdges(edges, current, C.BackDir);
+        for (auto d = GridDirection::begin(); d != (canPlaceVia(current) ? GridDirection::vend() : GridDirection::hend()); ++d) {
             NavPoint *node = edges[d.n()];
             if (!node)
                 continue;
-            const auto score = current->getScore() + computeCost(current, node, d);
-            if (node->getVisits().isSeen(seq) && score >= node->getScore())
-                continue;
-            node->setBackDirection(d.opposite());
-            node->setScore(score);
-            node->getVisits().setOpen(seq);
-            openList.push(NavPointRef(node, heuristic(*node)));
+            relax(node, d, C.Score + computeCost(node, d, C.BackDir), seq, openList);
         }
 #if GYM_PCB_ENABLE_UI
         mNav.getPCB().setChanged(PCB_CHANGED_NAV_GRID);
@@ -366,6 +1141,160 @@ int AStar::_search(NavPoint *source, int maxVisits)
     return -maxVisits;
 }
 
+template<class OpenList> int AStar::_searchBidirectional(NavPoint *source, int maxVisits)
+{
+    auto &rws = mWS.getReverse();
+    rws.init(mNav, mWS.getBox());
+    const uint seq = mWS.nextSeq();
+    const uint rseq = rws.nextSeq();
+
+    OpenList openList(mNav, mWS);
+    OpenList openListReverse(mNav, rws);
+
+    // The smallest scores on the open lists for the stopping criterion, stale entries are skipped like for the binary heap.
+    std::priority_queue<NavPointRef> openScores;
+    std::priority_queue<NavPointRef> openScoresReverse;
+
+    auto &S = mWS[*source];
+    S.Score = 0;
+    S.BackDir = GridDirection::Z();
+    S.Visits.setOpen(seq);
+    openList.push(source, mEpsilon * heuristic(*source, S.BackDir), false);
+    openScores.push(NavPointRef(source, 0.0f));
+
+    // The reverse search starts from all target cells like the forward search ends at any of them.
+    const auto &E = mEnds[0];
+    for (int z = E.z0; z <= E.z1; ++z) {
+        auto T = &mNav.getPoint(E.x, E.y, z);
+        auto &N = rws[*T];
+        N.Score = 0;
+        N.BackDir = GridDirection::Z();
+        N.Visits.setOpen(rseq);
+        openListReverse.push(T, mEpsilon * heuristicReverse(*T, N.BackDir), false);
+        openScoresReverse.push(NavPointRef(T, 0.0f));
+    }
+    if (mTreeActive) {
+        for (auto i : mTreeCells) {
+            auto T = &mNav.getPoint(i);
+            if (!mWS.contains(*T) || (getFlags(T) & mRouteMask) || rws[*T].Visits.isSeen(rseq))
+                continue;
+            auto &N = rws[*T];
+            N.Score = 0;
+            N.BackDir = GridDirection::Z();
+            N.Visits.setOpen(rseq);
+            openListReverse.push(T, mEpsilon * heuristicReverse(*T, N.BackDir), false);
+            openScoresReverse.push(NavPointRef(T, 0.0f));
+        }
+    }
+
+    NavPoint *meet = 0;
+    float best = std::numeric_limits<float>::infinity();
+    auto join = [&](NavPoint *P) {
+        const auto &F = mWS[*P];
+        const auto &R = rws[*P];
+        float score = F.Score + R.Score;
+        if (!R.BackDir.isZero())
+            score += joinCost(P->getEdge(mNav, R.BackDir), R.BackDir, F.BackDir);
+        if (score < best) {
+            best = score;
+            meet = P;
+        }
+    };
+    // The binary heap may have duplicates of nodes that are already done on top which would make our stopping criterion too weak.
+    auto skipDone = [](OpenList &list, const AStarWorkspace &ws, uint seq) {
+        while (!list.empty() && !ws[*list.top()].Visits.isOpen(seq))
+            list.pop();
+    };
+    auto minScore = [](std::priority_queue<NavPointRef> &scores, const AStarWorkspace &ws, uint seq) {
+        while (!scores.empty()) {
+            const auto &N = ws[*scores.top().getPoint()];
+            if (N.Visits.isOpen(seq) && N.Score == scores.top().getKey())
+                return scores.top().getKey();
+            scores.pop();
+        }
+        return std::numeric_limits<float>::infinity();
+    };
+
+    NavPoint *edges[GridDirection::Count];
+    while (true) {
+        skipDone(openList, mWS, seq);
+        skipDone(openListReverse, rws, rseq);
+        if (openList.empty() || openListReverse.empty())
+            break;
+        if (best <= minScore(openScores, mWS, seq) + minScore(openScoresReverse, rws, rseq))
+            break;
+        if (!--maxVisits || expired(maxVisits))
+            return 0;
+        if (openList.topKey() <= openListReverse.topKey()) {
+            auto current = openList.pop();
+            auto &C = mWS[*current];
+            C.Visits.setDone(seq);
+            explore(current);
+            getEdges(edges, current, C.BackDir);
+            for (auto d = GridDirection::begin(); d != (canPlaceVia(current) ? GridDirection::vend() : GridDirection::hend()); ++d) {
+                NavPoint *node = edges[d.n()];
+                if (!node || !relax(node, d, C.Score + computeCost(node, d, C.BackDir), seq, openList))
+                    continue;
+                openScores.push(NavPointRef(node, mWS[*node].Score));
+                if (rws[*node].Visits.isSeen(rseq))
+                    join(node);
+            }
+        } else {
+            auto current = openListReverse.pop();
+            auto &C = rws[*current];
+            C.Visits.setDone(rseq);
+            explore(current);
+            getEdges(edges, current, C.BackDir);
+            // Now that we know where the move from current comes from we can add its join cost.
+            const auto next = C.BackDir.isZero() ? 0 : current->getEdge(mNav, C.BackDir);
+            for (auto d = GridDirection::begin(); d != (canPlaceVia(current) ? GridDirection::vend() : GridDirection::hend()); ++d) {
+                NavPoint *node = edges[d.n()];
+                if (!node)
+                    continue;
+                float score = C.Score + computeCost(current, d.opposite(), d);
+                if (next)
+                    score += joinCost(next, C.BackDir, d);
+                if (!relaxReverse(rws, node, d.opposite(), score, rseq, openListReverse))
+                    continue;
+                openScoresReverse.push(NavPointRef(node, score));
+                if (mWS[*node].Visits.isSeen(seq))
+                    join(node);
+            }
+        }
+#if GYM_PCB_ENABLE_UI
+        mNav.getPCB().setChanged(PCB_CHANGED_NAV_GRID);
+        UserSettings::get().sleepForActionDelay();
+#endif
+    }
+    if (!meet || !spliceReverse(meet, rws))
+        return -maxVisits;
+    mPathCost = best;
+    return maxVisits;
+}
+
+/**
+ * Point the back directions of the reverse path from meet to the target the other way so reconstruct() can follow them.
+ * Points on the forward path are left alone in case the two paths overlap (the part in between is dropped).
+ */
+bool AStar::spliceReverse(NavPoint *meet, const AStarWorkspace &rws)
+{
+    std::unordered_set<const NavPoint *> head;
+    for (const NavPoint *P = meet; P; P = mWS[*P].BackDir.isZero() ? 0 : P->getEdge(mNav, mWS[*P].BackDir))
+        head.insert(P);
+    std::unordered_set<const NavPoint *> tail;
+    NavPoint *P = meet;
+    while (!rws[*P].BackDir.isZero()) {
+        const auto d = rws[*P].BackDir;
+        P = P->getEdge(mNav, d);
+        if (!tail.insert(P).second)
+            return false;
+        if (!head.count(P))
+            mWS[*P].BackDir = d.opposite();
+    }
+    mTarget = P;
+    return true;
+}
+
 void AStar::initCosts(const Connection &X)
 {
     assert(mCostParams.valid());
@@ -384,11 +1313,19 @@ void AStar::initCosts(const Connection &X)
 
     mViaCost = mCostParams.Via * X.defaultViaDiameter();
 
+    mEpsilon = mCostParams.Epsilon;
+
     mViolationCost = mCostParams.Violation;
     if (std::isinf(mCostParams.Violation))
         mRouteMask |= NAV_POINT_FLAG_ROUTE_TRACK_CLEARANCE;
     else
         mRouteMask &= ~NAV_POINT_FLAG_ROUTE_TRACK_CLEARANCE;
+
+    // Jumps require moves on a layer to cost the same in every direction (up to the diagonal factor).
+    // The reverse half of a bidirectional search cannot jump as it does not know the back directions.
+    mJumpPoints = mCostParams.JumpPoints && !mCostParams.Bidirectional && std::isinf(mCostParams.Violation) &&
+        (mCostParams.WrongDirection == 1.0f ||
+         std::all_of(mPreferredDirections.begin(), mPreferredDirections.end(), [](uint8_t m){ return m == 0xff; }));
 }
 
 #endif // GYM_PCB_ASTAR_H
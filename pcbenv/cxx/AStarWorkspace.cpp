@@ -0,0 +1,24 @@
+#include "AStarWorkspace.hpp"
+#include "NavGrid.hpp"
+
+void AStarWorkspace::init(const NavGrid &nav)
+{
+    init(nav, IBox_3(IPoint_3(0, 0, 0), IPoint_3(nav.getSize(0) - 1, nav.getSize(1) - 1, nav.getSize(2) - 1)));
+}
+
+/**
+ * Prepare the workspace for a search inside the box (grid indices, inclusive).
+ * The storage only ever grows and the visit status of nodes is kept, it is the sequence number that makes it invalid.
+ */
+void AStarWorkspace::init(const NavGrid &nav, const IBox_3 &box)
+{
+    if (!box.valid() || box.min.x < 0 || box.min.y < 0 || box.min.z < 0 ||
+        box.max.x >= int(nav.getSize(0)) || box.max.y >= int(nav.getSize(1)) || box.max.z >= int(nav.getSize(2)))
+        throw std::invalid_argument("A-star window must be inside the grid");
+    mBox = box;
+    mStrideY = box.w();
+    mStrideZ = box.w() * box.h();
+    mBase = (box.volume() == int64_t(nav.getNumPoints())) ? &nav.getPoint(0) : 0;
+    if (mNodes.size() < size_t(box.volume()))
+        mNodes.resize(box.volume());
+}
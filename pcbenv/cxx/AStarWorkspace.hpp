@@ -0,0 +1,120 @@
+
+#ifndef GYM_PCB_ASTARWORKSPACE_H
+#define GYM_PCB_ASTARWORKSPACE_H
+
+#include "NavPoint.hpp"
+#include "Util/HugePageAllocator.hpp"
+#include <memory>
+
+class NavGrid;
+
+/// This class is used to keep track of whether a NavPoint has been visited in the current invocation of A*.
+/// We use a sequence number so we don't have to reset all visited nodes each time (until the sequence wraps).
+class AStarVisitStatus
+{
+public:
+    void reset() { mSeq = 0; }
+    void setOpen(uint16_t seq) { mSeq = seq; }
+    void setDone(uint16_t seq) { assert(isOpen(seq)); mSeq = seq | 0x8000; }
+    bool isSeen(uint16_t seq) const { return (mSeq & 0x7fff) == seq; }
+    bool isOpen(uint16_t seq) const { return mSeq == seq; }
+    bool isDone(uint16_t seq) const { return mSeq == (seq | 0x8000); }
+private:
+    uint16_t mSeq{0};
+};
+
+/**
+ * The state of an A* search for each grid point inside the search window.
+ * A* does not write to the NavGrid, so multiple threads can search the same grid if each uses its own workspace.
+ * The NavGrid owns a workspace for the single-threaded case, which is also the one the UI displays.
+ */
+class AStarWorkspace
+{
+public:
+    struct Node
+    {
+        float Score;
+        uint32_t HeapPos; //!< Position in AStarIndexedHeap, valid while the node is open.
+        AStarVisitStatus Visits;
+        GridDirection BackDir;
+    };
+    /// What the last search depends on: its result cannot change unless the costs or flags of cells inside Explored change.
+    /// The statistics below it are only for inspection (sreps::AStarStats).
+    struct Result
+    {
+        IBox_3 Explored; //!< cells read by the search (conservative), invalid if there was none
+        std::vector<uint32_t> Path; //!< grid indices of the cells on the path found (empty if none)
+        uint64_t Visits{0}; //!< nodes expanded by all searches for the connection
+        float Cost{std::numeric_limits<float>::infinity()}; //!< cost of the path found
+        std::vector<float> Costs; //!< costs of the successive paths found by an anytime search
+        int8_t Corridor{-1}; //!< -1 if not requested, 1 if the path was searched inside the corridor, 0 if not
+        uint32_t OutsideCorridor{0}; //!< number of cells on the path that are outside the corridor
+        void reset() { Path.clear(); Visits = 0; Cost = std::numeric_limits<float>::infinity(); Costs.clear(); Corridor = -1; OutsideCorridor = 0; }
+    };
+public:
+    void init(const NavGrid&);
+    void init(const NavGrid&, const IBox_3&);
+
+    const IBox_3& getBox() const { return mBox; }
+    bool contains(const NavPoint&) const;
+
+    Node& operator[](const NavPoint &P) { return mNodes[index(P)]; }
+    const Node& operator[](const NavPoint &P) const { return mNodes[index(P)]; }
+    const Node *find(const NavPoint &P) const { return contains(P) ? &mNodes[index(P)] : 0; }
+
+    uint16_t nextSeq();
+    uint16_t getSeq() const { return mSeq; }
+
+    const Result& getResult() const { return mResult; }
+    Result& getResult() { return mResult; }
+
+    /// The workspace for the reverse half of a bidirectional search.
+    AStarWorkspace& getReverse();
+
+    size_t getMemoryUsage() const { return mNodes.capacity() * sizeof(Node) + (mReverse ? mReverse->getMemoryUsage() : 0); }
+private:
+    std::vector<Node, AlignedTHPAllocator<Node>> mNodes;
+    std::unique_ptr<AStarWorkspace> mReverse;
+    const NavPoint *mBase{0}; //!< Grid point 0 if the window is the whole grid, else null.
+    IBox_3 mBox{IBox_3::EMPTY()};
+    uint mStrideY{0};
+    uint mStrideZ{0};
+    uint16_t mSeq{0}; //!< To mark nodes already visited during an instance of A-star.
+    Result mResult;
+
+    uint index(const NavPoint&) const;
+};
+
+inline bool AStarWorkspace::contains(const NavPoint &P) const
+{
+    return P.x() >= mBox.min.x && P.x() <= mBox.max.x &&
+           P.y() >= mBox.min.y && P.y() <= mBox.max.y &&
+           P.z() >= mBox.min.z && P.z() <= mBox.max.z;
+}
+
+inline uint AStarWorkspace::index(const NavPoint &P) const
+{
+    assert(contains(P));
+    if (mBase)
+        return &P - mBase;
+    return (P.z() - mBox.min.z) * mStrideZ + (P.y() - mBox.min.y) * mStrideY + (P.x() - mBox.min.x);
+}
+
+inline AStarWorkspace& AStarWorkspace::getReverse()
+{
+    if (!mReverse)
+        mReverse = std::make_unique<AStarWorkspace>();
+    return *mReverse;
+}
+
+inline uint16_t AStarWorkspace::nextSeq()
+{
+    if (mSeq == 0x7fff) { // 0x8000 is used to indicate that a point is on A-star's open list
+        mSeq = 0;
+        for (auto &N : mNodes)
+            N.Visits.reset();
+    }
+    return ++mSeq;
+}
+
+#endif // GYM_PCB_ASTARWORKSPACE_H
@@ -611,8 +611,14 @@ bool Connection::intersects(const Connection &X) const
 
 Connection *Connection::clone(CloneEnv &env) const
 {
-    auto X = new Connection(env.N[mNet], mSource, mSourcePin, mTarget, mTargetPin);
+    auto sourcePin = mSourcePin ? env.P.at(mSourcePin) : 0;
+    auto targetPin = mTargetPin ? env.P.at(mTargetPin) : 0;
+    auto X = new Connection(env.N[mNet], mSource, sourcePin, mTarget, targetPin);
     env.X[this] = X;
+    if (sourcePin)
+        sourcePin->addConnection(X);
+    if (targetPin)
+        targetPin->addConnection(X);
     for (auto T : mTracks)
         X->mTracks.push_back(new Track(*T));
     X->setParametersFrom(*this);
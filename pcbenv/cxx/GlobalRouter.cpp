@@ -0,0 +1,159 @@
+#include "GlobalRouter.hpp"
+#include "NavGrid.hpp"
+#include <queue>
+
+/// Cost multiplier for tiles that are completely blocked except for a single cell (scaled linearly with the blocked fraction).
+#define GLOBAL_ROUTER_BLOCKAGE_COST 4.0f
+
+GlobalRouter::GlobalRouter(const NavGrid &nav, uint tileSize) : mNav(nav), mTileSize(tileSize)
+{
+    if (!tileSize)
+        throw std::invalid_argument("global router tile size must be > 0");
+}
+
+void GlobalRouter::setCosts(float via, uint32_t layerMask, float maskedLayer)
+{
+    mViaCost = via;
+    mLayerMask = layerMask;
+    mMaskedLayerCost = maskedLayer;
+}
+
+void GlobalRouter::initTiles(const IBox_3 &box)
+{
+    mBox = box;
+    mSize[0] = (box.w() + mTileSize - 1) / mTileSize;
+    mSize[1] = (box.h() + mTileSize - 1) / mTileSize;
+    mSize[2] = box.d();
+    const uint n = mSize[0] * mSize[1] * mSize[2];
+    mTiles.assign(n, Tile{0.0f, 0.0f, 0.0f});
+    std::vector<uint> count(n, 0);
+    for (int z = box.min.z; z <= box.max.z; ++z) {
+        for (int y = box.min.y; y <= box.max.y; ++y) {
+            const NavPoint *P = &mNav.getPoint(box.min.x, y, z);
+            for (int x = box.min.x; x <= box.max.x; ++x, ++P) {
+                const uint t = index(x, y, z);
+                auto &T = mTiles[t];
+                count[t] += 1;
+                if (P->canRoute()) {
+                    T.Free += 1.0f;
+                    T.Cost += P->getCost();
+                }
+                if (P->canPlaceVia())
+                    T.FreeVias += 1.0f;
+            }
+        }
+    }
+    for (uint t = 0; t < n; ++t) {
+        auto &T = mTiles[t];
+        T.Cost = (T.Free > 0.0f) ? (T.Cost / T.Free) : 1.0f;
+        T.Free /= count[t];
+        T.FreeVias /= count[t];
+    }
+}
+
+/**
+ * The endpoint tiles must be passable even if the pin itself blocks them (A* lifts the blockage in the endpoint column).
+ */
+void GlobalRouter::setEndPoint(const NavPoint &P, const int Z[2])
+{
+    for (int z = std::max(Z[0], mBox.min.z); z <= std::min(Z[1], mBox.max.z); ++z) {
+        auto &T = mTiles[index(P.x(), P.y(), z)];
+        T.Free = std::max(T.Free, 1.0f / (mTileSize * mTileSize));
+        T.FreeVias = std::max(T.FreeVias, 1.0f / (mTileSize * mTileSize));
+    }
+}
+
+/**
+ * Find the cheapest route from A (on layers ZA) to B (on layers ZB) on the tile graph and set the corridor around it.
+ * @param box The grid cells to consider, must contain A and B.
+ * @return Whether a route was found.
+ */
+bool GlobalRouter::route(const NavPoint &A, const int ZA[2], const NavPoint &B, const int ZB[2], const IBox_3 &box)
+{
+    initTiles(box);
+    setEndPoint(A, ZA);
+    setEndPoint(B, ZB);
+
+    const uint n = mTiles.size();
+    mScore.assign(n, std::numeric_limits<float>::infinity());
+    mBack.assign(n, -1);
+
+    using Entry = std::pair<float, uint>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+    for (int z = std::max(ZA[0], box.min.z); z <= std::min(ZA[1], box.max.z); ++z) {
+        const uint t = index(A.x(), A.y(), z);
+        mScore[t] = 0.0f;
+        open.push(Entry(0.0f, t));
+    }
+    const uint bi = (B.x() - box.min.x) / mTileSize;
+    const uint bj = (B.y() - box.min.y) / mTileSize;
+
+    int goal = -1;
+    while (!open.empty()) {
+        const auto [score, t] = open.top();
+        open.pop();
+        if (score > mScore[t])
+            continue;
+        const uint i = t % mSize[0];
+        const uint j = (t / mSize[0]) % mSize[1];
+        const uint k = t / (mSize[0] * mSize[1]);
+        const int z = box.min.z + k;
+        if (i == bi && j == bj && z >= ZB[0] && z <= ZB[1]) {
+            goal = t;
+            break;
+        }
+        auto relax = [&](uint u, float cost) {
+            if (score + cost < mScore[u]) {
+                mScore[u] = score + cost;
+                mBack[u] = t;
+                open.push(Entry(mScore[u], u));
+            }
+        };
+        const float layerCost = (mLayerMask & (1 << z)) ? 1.0f : mMaskedLayerCost;
+        for (int dj = -1; dj <= 1; ++dj) {
+            for (int di = -1; di <= 1; ++di) {
+                if ((!di && !dj) || (!i && di < 0) || (!j && dj < 0) || (i + di >= mSize[0]) || (j + dj >= mSize[1]))
+                    continue;
+                const uint u = tileIndex(i + di, j + dj, k);
+                const auto &U = mTiles[u];
+                if (U.Free <= 0.0f)
+                    continue;
+                const float len = (di && dj) ? std::sqrt(2.0f) : 1.0f;
+                relax(u, mTileSize * len * layerCost * U.Cost * (1.0f + GLOBAL_ROUTER_BLOCKAGE_COST * (1.0f - U.Free)));
+            }
+        }
+        for (int dk = -1; dk <= 1; dk += 2) {
+            if ((!k && dk < 0) || (k + dk >= mSize[2]))
+                continue;
+            const uint u = tileIndex(i, j, k + dk);
+            const float free = std::min(mTiles[t].FreeVias, mTiles[u].FreeVias);
+            if (free <= 0.0f)
+                continue;
+            relax(u, mViaCost * (1.0f + GLOBAL_ROUTER_BLOCKAGE_COST * (1.0f - free)));
+        }
+    }
+    if (goal < 0)
+        return false;
+
+    mCorridor.assign(n, false);
+    for (int t = goal; t >= 0; t = mBack[t])
+        setCorridor(t);
+    for (int z = std::max(ZA[0], box.min.z); z <= std::min(ZA[1], box.max.z); ++z)
+        setCorridor(index(A.x(), A.y(), z));
+    for (int z = std::max(ZB[0], box.min.z); z <= std::min(ZB[1], box.max.z); ++z)
+        setCorridor(index(B.x(), B.y(), z));
+    return true;
+}
+
+/**
+ * Add tile t and its 8 neighbours on the same layer to the corridor.
+ */
+void GlobalRouter::setCorridor(uint t)
+{
+    const int i = t % mSize[0];
+    const int j = (t / mSize[0]) % mSize[1];
+    const int k = t / (mSize[0] * mSize[1]);
+    for (int v = std::max(j - 1, 0); v <= std::min(j + 1, int(mSize[1]) - 1); ++v)
+        for (int u = std::max(i - 1, 0); u <= std::min(i + 1, int(mSize[0]) - 1); ++u)
+            mCorridor[tileIndex(u, v, k)] = true;
+}
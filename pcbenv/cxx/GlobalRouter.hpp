@@ -0,0 +1,49 @@
+#ifndef GYM_PCB_GLOBALROUTER_H
+#define GYM_PCB_GLOBALROUTER_H
+
+#include "NavPoint.hpp"
+
+class NavGrid;
+
+/**
+ * Coarse routing on a graph of square tiles of NavGrid cells (one tile graph per layer, connected by vias).
+ * Each tile gets a capacity estimate from the fraction of its cells that are not blocked for tracks (or vias),
+ * and the average cost of those cells so that RRR history costs carry over.
+ * The tiles along the coarse route plus their neighbours on the same layer form the corridor
+ * that A* is then restricted to (AStarCosts::Corridor).
+ */
+class GlobalRouter
+{
+    struct Tile
+    {
+        float Cost; //!< average cost of the free cells
+        float Free; //!< fraction of cells where tracks can be routed
+        float FreeVias; //!< fraction of cells where vias can be placed
+    };
+public:
+    GlobalRouter(const NavGrid&, uint tileSize);
+    void setCosts(float via, uint32_t layerMask, float maskedLayer);
+    bool route(const NavPoint &A, const int ZA[2], const NavPoint &B, const int ZB[2], const IBox_3 &box);
+    bool contains(const NavPoint &P) const { return mCorridor[index(P.x(), P.y(), P.z())]; }
+    uint getTileSize() const { return mTileSize; }
+private:
+    const NavGrid &mNav;
+    const uint mTileSize;
+    float mViaCost{1.0f};
+    uint32_t mLayerMask{0xffffffff};
+    float mMaskedLayerCost{1.0f};
+    IBox_3 mBox; //!< grid cells covered (the search window)
+    uint mSize[3]; //!< number of tiles in x, y, z
+    std::vector<Tile> mTiles;
+    std::vector<bool> mCorridor; //!< tile mask
+    std::vector<float> mScore;
+    std::vector<int> mBack;
+
+    uint index(int x, int y, int z) const { return tileIndex((x - mBox.min.x) / mTileSize, (y - mBox.min.y) / mTileSize, z - mBox.min.z); }
+    uint tileIndex(uint i, uint j, uint k) const { return (k * mSize[1] + j) * mSize[0] + i; }
+    void initTiles(const IBox_3&);
+    void setCorridor(uint t);
+    void setEndPoint(const NavPoint&, const int Z[2]);
+};
+
+#endif // GYM_PCB_GLOBALROUTER_H
@@ -0,0 +1,67 @@
+#include "NavConnectivity.hpp"
+#include "NavGrid.hpp"
+#include "Log.hpp"
+
+/**
+ * Join P with the neighbours it can reach in one move.
+ * Diagonal moves are only allowed if both adjacent straight moves are, so the straight ones are sufficient.
+ */
+void NavConnectivity::uniteNeighbours(const NavPoint &P)
+{
+    const uint32_t i = &P - &mNav.getPoint(0);
+    if (P.canRoute()) {
+        for (auto d : { GridDirection::U(), GridDirection::R(), GridDirection::D(), GridDirection::L() })
+            if (auto N = P.getEdge(mNav, d); N && N->canRoute())
+                unite(i, N - &mNav.getPoint(0));
+    }
+    for (auto d = GridDirection::hend(); d != GridDirection::vend(); ++d)
+        if (auto N = P.getEdge(mNav, d); N && P.canAddVia(*N))
+            unite(i, N - &mNav.getPoint(0));
+}
+
+void NavConnectivity::build()
+{
+    DEBUG("Building NavGrid connected components.");
+    const uint N = mNav.getNumPoints();
+    mParent.resize(N);
+    for (uint i = 0; i < N; ++i)
+        mParent[i] = i;
+    for (uint i = 0; i < N; ++i) {
+        const auto &P = mNav.getPoint(i);
+        if (auto R = P.getEdge(mNav, GridDirection::R()); R && P.canRoute() && R->canRoute())
+            unite(i, i + 1);
+        if (auto U = P.getEdge(mNav, GridDirection::U()); U && P.canRoute() && U->canRoute())
+            unite(i, U - &mNav.getPoint(0));
+        if (auto A = P.getEdge(mNav, GridDirection::A()); A && P.canAddVia(*A))
+            unite(i, A - &mNav.getPoint(0));
+    }
+    mValid = true;
+    mNumBlocked = 0;
+}
+
+/**
+ * Whether there is a component with free cells in both boxes (grid indices, inclusive).
+ * If the boxes overlap we can't tell.
+ */
+bool NavConnectivity::mayConnect(const IBox_3 &A, const IBox_3 &B)
+{
+    if (A.min.x <= B.max.x && B.min.x <= A.max.x &&
+        A.min.y <= B.max.y && B.min.y <= A.max.y &&
+        A.min.z <= B.max.z && B.min.z <= A.max.z)
+        return true;
+    if (!mValid || mNumBlocked > mParent.size() / 16)
+        build();
+    std::vector<uint32_t> roots;
+    for (int z = A.min.z; z <= A.max.z; ++z)
+    for (int y = A.min.y; y <= A.max.y; ++y)
+    for (int x = A.min.x; x <= A.max.x; ++x)
+        if (const auto &P = mNav.getPoint(x, y, z); P.canRoute())
+            roots.push_back(find(&P - &mNav.getPoint(0)));
+    std::sort(roots.begin(), roots.end());
+    for (int z = B.min.z; z <= B.max.z; ++z)
+    for (int y = B.min.y; y <= B.max.y; ++y)
+    for (int x = B.min.x; x <= B.max.x; ++x)
+        if (const auto &P = mNav.getPoint(x, y, z); P.canRoute() && std::binary_search(roots.begin(), roots.end(), find(&P - &mNav.getPoint(0))))
+            return true;
+    return false;
+}
@@ -0,0 +1,71 @@
+#ifndef GYM_PCB_NAVCONNECTIVITY_H
+#define GYM_PCB_NAVCONNECTIVITY_H
+
+#include "NavPoint.hpp"
+#include "Util/HugePageAllocator.hpp"
+
+class NavGrid;
+
+/**
+ * Connected components (union-find) of the cells where tracks can be routed, connected vertically where vias can be placed.
+ * The components may be larger than the true ones but never smaller:
+ *  - Cells that become free are joined with their neighbours right away (update()).
+ *  - Cells that become blocked are ignored until enough of them accumulate to rebuild on the next query.
+ * Thus if two cells are in different components, A* cannot find a path between them.
+ * Changes that are undone afterwards (PCBoard::initPathfindingFor) are not tracked while suspended.
+ */
+class NavConnectivity
+{
+public:
+    NavConnectivity(NavGrid &nav) : mNav(nav) { }
+    void invalidate() { mValid = false; }
+    void suspend() { ++mSuspended; }
+    void resume() { assert(mSuspended); --mSuspended; }
+    void update(const NavPoint&, uint16_t flagsBefore);
+    bool isTracking() const { return mValid && !mSuspended; }
+    bool mayConnect(const IBox_3&, const IBox_3&);
+    size_t getMemoryUsage() const { return mParent.capacity() * sizeof(uint32_t); }
+private:
+    NavGrid &mNav;
+    std::vector<uint32_t, AlignedTHPAllocator<uint32_t>> mParent;
+    bool mValid{false};
+    uint mSuspended{0};
+    uint64_t mNumBlocked{0}; //!< number of cells that became blocked since build()
+
+    void build();
+    uint32_t find(uint32_t);
+    void unite(uint32_t, uint32_t);
+    void uniteNeighbours(const NavPoint&);
+};
+
+inline uint32_t NavConnectivity::find(uint32_t i)
+{
+    while (mParent[i] != i) {
+        mParent[i] = mParent[mParent[i]];
+        i = mParent[i];
+    }
+    return i;
+}
+inline void NavConnectivity::unite(uint32_t a, uint32_t b)
+{
+    a = find(a);
+    b = find(b);
+    if (a != b)
+        mParent[std::max(a, b)] = std::min(a, b);
+}
+
+/**
+ * Call after writing the flags of a grid point.
+ */
+inline void NavConnectivity::update(const NavPoint &P, uint16_t before)
+{
+    if (!mValid || mSuspended)
+        return;
+    const uint16_t after = P.getFlags();
+    if (after & ~before & NAV_POINT_FLAGS_VIAS_BLOCKED)
+        mNumBlocked++;
+    if ((before & ~after & NAV_POINT_FLAGS_VIAS_BLOCKED) || ((before ^ after) & NAV_POINT_FLAG_INSIDE_PIN))
+        uniteNeighbours(P);
+}
+
+#endif // GYM_PCB_NAVCONNECTIVITY_H
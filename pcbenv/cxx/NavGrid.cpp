@@ -1,6 +1,7 @@
 
 #include "PyArray.hpp"
 #include "NavGrid.hpp"
+#include "NavGridCache.hpp"
 #include "PCBoard.hpp"
 #include "Component.hpp"
 #include "Net.hpp"
@@ -10,6 +11,13 @@
 
 #include "AStar.hpp"
 #include "RasterizerMidpoint.hpp"
+#include <cstring>
+#include <thread>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 NavSpacings::NavSpacings(const Connection &X)
 {
@@ -30,9 +38,34 @@ NavGrid::NavGrid(PCBoard &pcb) : UniformGrid25(1.0), mPCB(pcb)
 void NavGrid::copyFrom(const NavGrid &nav)
 {
     assert(mPoints.size() == nav.mPoints.size());
+    dropSnapshot();
+    touchAll();
     mSpacings = nav.getSpacings();
+    mConnectivity.invalidate();
     for (uint i = 0; i < mPoints.size(); ++i)
         mPoints[i].copyFrom(nav.mPoints[i]);
+    mKOCounts = nav.mKOCounts;
+    mUserKeepouts = nav.mUserKeepouts;
+    mClearanceValid = nav.mClearanceValid;
+    mSpacingClasses = nav.mSpacingClasses;
+}
+
+/**
+ * Call f(i) for all i in [0, n) from up to hardware_concurrency() threads, each doing a contiguous range of at least minPerThread.
+ */
+template<typename F> static void parallelFor(uint n, uint minPerThread, F f)
+{
+    const uint numThreads = std::max(1u, std::min(std::thread::hardware_concurrency(), n / std::max(minPerThread, 1u)));
+    auto range = [&f, n, numThreads](uint t) {
+        for (uint i = uint64_t(n) * t / numThreads; i < uint64_t(n) * (t + 1) / numThreads; ++i)
+            f(i);
+    };
+    std::vector<std::thread> threads;
+    for (uint t = 1; t < numThreads; ++t)
+        threads.emplace_back(range, t);
+    range(0);
+    for (auto &T : threads)
+        T.join();
 }
 
 void NavGrid::build()
@@ -41,7 +74,16 @@ void NavGrid::build()
     mSize[1] = std::ceil(mPCB.getLayoutArea().size().y() / EdgeLen);
     mSize[0] = std::ceil(mPCB.getLayoutArea().size().x() / EdgeLen);
     calcNumPoints3D();
-    mPoints.resize(getNumPoints3D());
+    mPoints.clear();
+    mPoints.resize(getNumPoints3D()); // not initialized yet
+    mKOCounts.resize(getNumPoints3D());
+    mWriteSeqs.resize(getNumPoints3D());
+    mUserKeepouts.resize(getNumPoints3D());
+    mClearanceValid = false;
+    mSpacingClasses.clear();
+    dropSnapshot();
+    mSnapshot.TileEpochs.assign((getNumPoints3D() + NAV_GRID_TILE_SIZE - 1) / NAV_GRID_TILE_SIZE, 0);
+    mTileChangeSeqs.assign(mSnapshot.TileEpochs.size(), mChangeSeq);
 
     DEBUG("Building NavGrid of size " << mSize[0] << 'x' << mSize[1] << 'x' << mSize[2]);
 
@@ -52,19 +94,21 @@ void NavGrid::build()
     mStrideY = mSize[0];
     mStrideZ = mSize[1] * mStrideY;
     initDirectionStrides();
+    mConnectivity.invalidate();
 
-    // Rasterize these first so we can remove some edges.
-    rasterizeFootprints();
+    const uint numRows = mSize[1] * mSize[2];
+    const uint minRows = (1u << 16) / mSize[0] + 1;
 
-    // Loop twice so we can do some assertions the second time.
-    for (uint z = 0, i = 0; z < mSize[2]; ++z)
-    for (uint y = 0; y < mSize[1]; ++y)
-    for (uint x = 0; x < mSize[0]; ++x, ++i)
-        mPoints[i].setRefPoint(x, y, z);
-    for (uint z = 0, i = 0; z < mSize[2]; ++z)
-    for (uint y = 0; y < mSize[1]; ++y)
-    for (uint x = 0; x < mSize[0]; ++x, ++i)
-        initEdges(mPoints[i], IPoint_3(x,y,z));
+    NavGridCache cache(*this);
+    if (const NavPoint *cached = cache.map()) {
+        parallelFor(numRows, minRows, [this, cached](uint r) {
+            std::memcpy(&mPoints[r * mSize[0]], &cached[r * mSize[0]], mSize[0] * sizeof(NavPoint));
+        });
+        DEBUG("NavGrid loaded from cache.");
+    } else {
+        buildPoints(numRows, minRows);
+        cache.store(mPoints.data(), mPoints.size());
+    }
 
     // Mark existing tracks as rasterized so we don't skip them in rasterizeClearanceAreas().
     for (auto net : mPCB.getNets())
@@ -74,6 +118,29 @@ void NavGrid::build()
 
     DEBUG("NavGrid built.");
 }
+void NavGrid::buildPoints(uint numRows, uint minRows)
+{
+    // Construct the points row by row in parallel (first touch of the pages).
+    parallelFor(numRows, minRows, [this](uint r) {
+        const uint y = r % mSize[1];
+        const uint z = r / mSize[1];
+        for (uint x = 0, i = r * mSize[0]; x < mSize[0]; ++x, ++i) {
+            new (&mPoints[i]) NavPoint();
+            mPoints[i].setRefPoint(x, y, z);
+        }
+    });
+
+    // Rasterize these first so we can remove some edges.
+    rasterizeFootprints();
+
+    // This only writes the edges of each point and reads the flags of its neighbours.
+    parallelFor(numRows, minRows, [this](uint r) {
+        const uint y = r % mSize[1];
+        const uint z = r / mSize[1];
+        for (uint x = 0, i = r * mSize[0]; x < mSize[0]; ++x, ++i)
+            initEdges(mPoints[i], IPoint_3(x,y,z));
+    });
+}
 void NavGrid::initSpacingsForAnyRoutedTrack()
 {
     for (auto net : mPCB.getNets()) {
@@ -124,21 +191,70 @@ bool NavGrid::setSpacings(const NavSpacings &_spacings)
         spacings.ViaRadius = 0.0; // no vias for single layer boards
     if (mSpacings == spacings)
         return false;
+    saveSpacingClasses();
+    touchAllocated(mKOCounts); // only cells with KO counts can have CLEARANCE flags
     DEBUG("Grid spacings have changed:\nclearance: " << mSpacings.Clearance << " -> " << spacings.Clearance << "\ntrack halfwidth: " << mSpacings.TrackWidthHalf << " -> " << spacings.TrackWidthHalf << "\nvia radius: " << mSpacings.ViaRadius << " -> " << spacings.ViaRadius);
+
+    auto I = std::find_if(mSpacingClasses.begin(), mSpacingClasses.end(), [&](const NavSpacingClass &C) { return C.Spacings == spacings; });
+    if (I != mSpacingClasses.end()) {
+        touchAllocated(I->KOCounts);
+        std::swap(mSpacings, I->Spacings);
+        mKOCounts.swap(I->KOCounts);
+        std::rotate(mSpacingClasses.begin(), I, I + 1);
+        updateClearanceFlags(mSpacingClasses.front().KOCounts);
+        DEBUG("Switched to cached spacing class.");
+        return true;
+    }
+    const uint maxClasses = UserSettings::get().MaxGridSpacingClasses;
+    if (mClearanceValid && maxClasses > 1) {
+        if (mSpacingClasses.size() + 1 >= maxClasses)
+            mSpacingClasses.pop_back();
+        mSpacingClasses.insert(mSpacingClasses.begin(), NavSpacingClass{mSpacings, std::move(mKOCounts)});
+        mKOCounts.resize(getNumPoints());
+    }
     mSpacings = spacings;
     rasterizeClearanceAreas();
+    DEBUG("NavGrid uses " << (getMemoryUsage() >> 20) << " MiB after rasterizing clearance areas.");
     return true;
 }
 
+size_t NavGrid::getMemoryUsage() const
+{
+    size_t size = mPoints.capacity() * sizeof(NavPoint) + mKOCounts.getMemoryUsage() + mWriteSeqs.getMemoryUsage() + mUserKeepouts.getMemoryUsage() + mConnectivity.getMemoryUsage();
+    for (const auto &C : mSpacingClasses)
+        size += C.KOCounts.getMemoryUsage();
+    for (const auto &C : mSnapshot.SpacingClasses)
+        size += C.KOCounts.getMemoryUsage();
+    size += mSnapshot.TileEpochs.capacity() * sizeof(uint32_t) + mSnapshot.Tiles.capacity() * sizeof(NavGridTileCopy);
+    return size;
+}
+
+/**
+ * Set the CLEARANCE flags from the KO counts after switching to a cached spacing class.
+ * Only the tiles that have counts before or after the switch can change.
+ */
+void NavGrid::updateClearanceFlags(const SparseTiles<NavKeepoutCounts> &before)
+{
+    const uint S = SparseTiles<NavKeepoutCounts>::TileSize;
+    for (uint k = 0; k < mKOCounts.numTiles(); ++k) {
+        if (!mKOCounts.hasTile(k) && !before.hasTile(k))
+            continue;
+        for (uint i = k * S; i < std::min((k + 1) * S, getNumPoints()); ++i) {
+            mPoints[i].clearFlags(NAV_POINT_FLAGS_CLEARANCE);
+            mPoints[i].setFlags(mKOCounts.get(i).getFlags());
+        }
+    }
+    mConnectivity.invalidate();
+}
+
 void NavGrid::resetUserKeepout(uint idx)
 {
-    for (NavPoint &P : mPoints)
-        P.getKOCounts()._User[idx] = 0;
+    forEachUserKeepouts([idx](NavUserKeepouts &U){ U._User[idx] = 0; });
 }
 void NavGrid::resetUserKeepouts()
 {
-    for (NavPoint &P : mPoints)
-        P.getKOCounts()._User[0] = P.getKOCounts()._User[1] = 0;
+    touchAllocated(mUserKeepouts);
+    mUserKeepouts.clear();
 }
 void NavGrid::resetKeepouts()
 {
@@ -147,8 +263,17 @@ void NavGrid::resetKeepouts()
             for (auto T : X->getTracks())
                 T->resetRasterizedCount();
 
+    mConnectivity.invalidate();
+    mSpacingClasses.clear();
+    resetKO();
+    mClearanceValid = false;
+}
+void NavGrid::resetKO()
+{
+    touchAllocated(mKOCounts);
+    mKOCounts.clear();
     for (NavPoint &P : mPoints)
-        P.resetKO();
+        P.clearFlags(NAV_POINT_FLAGS_CLEARANCE);
 }
 
 void NavGrid::rasterizeFootprints()
@@ -174,8 +299,8 @@ void NavGrid::rasterizeFootprints()
 
 void NavGrid::rasterizeClearanceAreas()
 {
-    for (NavPoint &P : mPoints)
-        P.resetKO();
+    mConnectivity.invalidate();
+    resetKO();
 
     NavRasterizeParams rast;
     rast.AutoExpand = true;
@@ -196,6 +321,7 @@ void NavGrid::rasterizeClearanceAreas()
                 rasterize(*X, rast);
 
     rasterizeLayoutAreaBorder(rast);
+    mClearanceValid = true;
 }
 
 class NavROP final : public BaseROP
@@ -211,20 +337,145 @@ private:
 };
 inline void NavROP::writeIndex(uint i) const
 {
-    mGrid->getPoint(i).write(*mParams);
+    auto &P = mGrid->getPoint(i);
+    const auto flags = P.getFlags();
+    mGrid->write(i, *mParams);
+    mGrid->getConnectivity().update(P, flags);
 }
+/**
+ * Rows are written as spans. The connectivity only needs to see the points whose flags changed.
+ */
 inline void NavROP::writeRangeZYX(uint Z0, uint Z1, uint Y0, uint Y1, uint X0, uint X1)
 {
     assert(mGrid);
+    auto &C = mGrid->getConnectivity();
+    uint16_t before[NAV_GRID_TILE_SIZE];
     for (uint Z = Z0; Z <= Z1; ++Z) {
     for (uint Y = Y0; Y <= Y1; ++Y) {
-        const auto I0 = mGrid->LinearIndex(Z, Y, X0);
-        const auto I1 = I0 + (X1 - X0);
-        for (uint i = I0; i <= I1; ++i)
-            writeIndex(i);
+        uint i = mGrid->LinearIndex(Z, Y, X0);
+        uint n = X1 - X0 + 1;
+        if (!C.isTracking()) {
+            mGrid->writeSpan(i, n, *mParams);
+            continue;
+        }
+        while (n) {
+            const uint m = std::min(n, NAV_GRID_TILE_SIZE);
+            for (uint j = 0; j < m; ++j)
+                before[j] = mGrid->getPoint(i + j).getFlags();
+            mGrid->writeSpan(i, m, *mParams);
+            for (uint j = 0; j < m; ++j)
+                if (mGrid->getPoint(i + j).getFlags() != before[j])
+                    C.update(mGrid->getPoint(i + j), before[j]);
+            i += m;
+            n -= m;
+        }
     }}
 }
 
+/**
+ * Split the span at tile boundaries so that the KO counts and write sequence numbers are contiguous.
+ */
+void NavGrid::writeSpan(uint i, uint n, const NavRasterizeParams &params)
+{
+    if (mWritingSpacingClass) {
+        for (uint j = 0; j < n; ++j)
+            write(i + j, params);
+        return;
+    }
+    const bool count = !params.KOCount.isZero();
+    while (n) {
+        const uint k = i / NAV_GRID_TILE_SIZE;
+        const uint m = std::min(n, NAV_GRID_TILE_SIZE - i % NAV_GRID_TILE_SIZE);
+        touchTile(k);
+        NavKeepoutCounts *KO = (count || mKOCounts.hasTile(k)) ? &mKOCounts.ref(i) : 0;
+        uint16_t *seqs = count ? &mWriteSeqs.ref(i) : 0;
+        NavPoint::writeSpan(&mPoints[i], KO, seqs, m, params);
+        i += m;
+        n -= m;
+    }
+}
+
+/**
+ * NavPoint::write() for n consecutive points with contiguous KO counts and write sequence numbers.
+ * Without @seqs the counts are only read (null for all 0) and params.KOCount must be 0, as in NavGrid::write().
+ * NavPoints are interleaved so their flags are moved with scalar loads and stores, everything else is done for 8 points at a time.
+ */
+void NavPoint::writeSpan(NavPoint *P, NavKeepoutCounts *KO, uint16_t *seqs, uint n, const NavRasterizeParams &params)
+{
+    assert(seqs ? (KO != 0) : params.KOCount.isZero());
+    uint j = 0;
+#if defined(__AVX2__) || defined(__ARM_NEON)
+    // The CLEARANCE flag for each byte of NavKeepoutCounts.
+    constexpr const uint32_t ClearanceBits =
+        (NAV_POINT_FLAG_ROUTE_TRACK_CLEARANCE << 0) | (NAV_POINT_FLAG_ROUTE_VIA_CLEARANCE << 8) |
+        (NAV_POINT_FLAG_PIN_TRACK_CLEARANCE << 16) | (NAV_POINT_FLAG_PIN_VIA_CLEARANCE << 24);
+    static_assert(NAV_POINT_FLAGS_CLEARANCE <= 0xff && sizeof(NavKeepoutCounts) == 4);
+    alignas(16) uint16_t F[8];
+    for (; j + 8 <= n; j += 8) {
+        for (uint k = 0; k < 8; ++k)
+            F[k] = P[j + k].mFlags;
+#if defined(__AVX2__)
+        const __m128i f = _mm_load_si128(reinterpret_cast<const __m128i *>(F));
+        const __m128i seq = _mm_set1_epi16(params.WriteSeq);
+        const __m128i s = seqs ? _mm_loadu_si128(reinterpret_cast<const __m128i *>(&seqs[j])) : _mm_setzero_si128();
+        const __m128i same = seqs ? _mm_cmpeq_epi16(s, seq) : _mm_setzero_si128();
+        const __m128i active = _mm_andnot_si128(same, _mm_cmpeq_epi16(_mm_and_si128(f, _mm_set1_epi16(params.IgnoreMask)), _mm_setzero_si128()));
+        __m256i ko = KO ? _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&KO[j])) : _mm256_setzero_si256();
+        if (seqs) {
+            ko = _mm256_add_epi8(ko, _mm256_and_si256(_mm256_set1_epi32(params.KOCount._all), _mm256_cvtepi16_epi32(active)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(&KO[j]), ko);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(&seqs[j]), _mm_blendv_epi8(s, seq, active));
+        }
+        __m256i c = _mm256_andnot_si256(_mm256_cmpeq_epi8(ko, _mm256_setzero_si256()), _mm256_set1_epi32(ClearanceBits));
+        c = _mm256_or_si256(c, _mm256_srli_epi32(c, 8));
+        c = _mm256_and_si256(_mm256_or_si256(c, _mm256_srli_epi32(c, 16)), _mm256_set1_epi32(0xff));
+        __m128i w = _mm_or_si128(_mm_andnot_si128(_mm_set1_epi16(NAV_POINT_FLAGS_CLEARANCE), f), _mm_packus_epi32(_mm256_castsi256_si128(c), _mm256_extracti128_si256(c, 1)));
+        w = _mm_or_si128(_mm_and_si128(w, _mm_set1_epi16(params.FlagsAnd)), _mm_set1_epi16(params.FlagsOr));
+        _mm_store_si128(reinterpret_cast<__m128i *>(F), _mm_blendv_epi8(f, w, active));
+#else
+        const uint16x8_t f = vld1q_u16(F);
+        const uint16x8_t seq = vdupq_n_u16(params.WriteSeq);
+        const uint16x8_t s = seqs ? vld1q_u16(&seqs[j]) : vdupq_n_u16(0);
+        const uint16x8_t same = seqs ? vceqq_u16(s, seq) : vdupq_n_u16(0);
+        const uint16x8_t active = vbicq_u16(vceqq_u16(vandq_u16(f, vdupq_n_u16(params.IgnoreMask)), vdupq_n_u16(0)), same);
+        const uint32x4_t active0 = vreinterpretq_u32_s32(vmovl_s16(vreinterpret_s16_u16(vget_low_u16(active))));
+        const uint32x4_t active1 = vreinterpretq_u32_s32(vmovl_s16(vreinterpret_s16_u16(vget_high_u16(active))));
+        uint8x16_t ko0 = KO ? vld1q_u8(reinterpret_cast<const uint8_t *>(&KO[j])) : vdupq_n_u8(0);
+        uint8x16_t ko1 = KO ? vld1q_u8(reinterpret_cast<const uint8_t *>(&KO[j + 4])) : vdupq_n_u8(0);
+        if (seqs) {
+            const uint32x4_t d = vdupq_n_u32(params.KOCount._all);
+            ko0 = vaddq_u8(ko0, vreinterpretq_u8_u32(vandq_u32(d, active0)));
+            ko1 = vaddq_u8(ko1, vreinterpretq_u8_u32(vandq_u32(d, active1)));
+            vst1q_u8(reinterpret_cast<uint8_t *>(&KO[j]), ko0);
+            vst1q_u8(reinterpret_cast<uint8_t *>(&KO[j + 4]), ko1);
+            vst1q_u16(&seqs[j], vbslq_u16(active, seq, s));
+        }
+        const auto clearance = [ClearanceBits](uint8x16_t ko) {
+            uint32x4_t c = vandq_u32(vreinterpretq_u32_u8(vtstq_u8(ko, ko)), vdupq_n_u32(ClearanceBits));
+            c = vorrq_u32(c, vshrq_n_u32(c, 8));
+            return vmovn_u32(vandq_u32(vorrq_u32(c, vshrq_n_u32(c, 16)), vdupq_n_u32(0xff)));
+        };
+        uint16x8_t w = vorrq_u16(vbicq_u16(f, vdupq_n_u16(NAV_POINT_FLAGS_CLEARANCE)), vcombine_u16(clearance(ko0), clearance(ko1)));
+        w = vorrq_u16(vandq_u16(w, vdupq_n_u16(params.FlagsAnd)), vdupq_n_u16(params.FlagsOr));
+        vst1q_u16(F, vbslq_u16(active, w, f));
+#endif
+        for (uint k = 0; k < 8; ++k)
+            P[j + k].mFlags = F[k];
+    }
+#endif // __AVX2__ || __ARM_NEON
+    for (; j < n; ++j) {
+        if (seqs) {
+            P[j].write(params, KO[j], seqs[j]);
+        } else {
+            NavKeepoutCounts ko;
+            if (KO)
+                ko = KO[j];
+            uint16_t seq = params.WriteSeq - 1;
+            P[j].write(params, ko, seq);
+        }
+    }
+}
+
 /**
  * We need to rasterize the border to make sure tracks don't exceed the layout area.
  * FIXME: This is inaccurate for wider tracks at angles other than 0°/90° with the border.
@@ -337,6 +588,27 @@ void NavGrid::rasterize(const Connection &X, const NavRasterizeParams &_params)
             rasterize(*T, params2, RASTERIZE_MASK_SEGMENTS | RASTERIZE_MASK_CAPS_AND_JUNCTIONS);
         T->addRasterizedCount(_params.TrackRasterCount);
     }
+    if (_params.TrackRasterCount && !mSpacingClasses.empty())
+        rasterizeSpacingClasses(X, _params);
+}
+
+/**
+ * Apply a lasting change of the connection's tracks to the KO counts of the cached spacing classes.
+ */
+void NavGrid::rasterizeSpacingClasses(const Connection &X, const NavRasterizeParams &_params)
+{
+    NavRasterizeParams params = _params;
+    params.TrackRasterCount = 0;
+    mWritingSpacingClass = true;
+    saveSpacingClasses();
+    for (auto &C : mSpacingClasses) {
+        std::swap(mSpacings, C.Spacings);
+        mKOCounts.swap(C.KOCounts);
+        rasterize(X, params);
+        mKOCounts.swap(C.KOCounts);
+        std::swap(mSpacings, C.Spacings);
+    }
+    mWritingSpacingClass = false;
 }
 
 void NavGrid::rasterize(const Track &T, const NavRasterizeParams &params, uint mask)
@@ -363,23 +635,23 @@ void NavGrid::rasterize(const Path &path, const NavRasterizeParams &params)
             R.rasterizeLine(path.getSegmentTo(i));
 }
 
-void NavGrid::resetSearchSeq()
-{
-    mSearchSeq = 0;
-    for (auto &v : mPoints)
-        v.getVisits().reset();
-}
 void NavGrid::resetRasterSeq()
 {
     mRasterSeq = 0;
-    for (auto &v : mPoints)
-        v.setWriteSeq(0);
+    mWriteSeqs.clear();
 }
 
 bool NavGrid::findPathAStar(Connection &X, const AStarCosts *costs)
+{
+    return findPathAStar(X, costs, mAStarWorkspace);
+}
+/**
+ * The search itself does not modify the grid, so this can be called from multiple threads with a different workspace each.
+ */
+bool NavGrid::findPathAStar(Connection &X, const AStarCosts *costs, AStarWorkspace &ws)
 {
     assert(X.defaultViaDiameter() > 0.0);
-    return AStar(*this, costs ? *costs : mAStarCosts).search(X);
+    return AStar(*this, costs ? *costs : mAStarCosts, ws).search(X);
 }
 
 void NavGrid::getCosts(std::vector<float> &costs)
@@ -390,12 +662,14 @@ void NavGrid::getCosts(std::vector<float> &costs)
 }
 void NavGrid::setCosts(float v)
 {
+    touchAll();
     for (uint i = 0; i < mPoints.size(); ++i)
         mPoints[i].setCost(v);
 }
 void NavGrid::setCosts(const float *data, float v)
 {
     assert(data);
+    touchAll();
     for (uint i = 0; i < mPoints.size(); ++i)
         mPoints[i].setCost(v + data[i]);
 }
@@ -410,8 +684,10 @@ void NavGrid::setCosts(const IBox_3 &box, const float *data, const float v)
     uint i = 0;
     for (int z = box.min.z; z <= box.max.z; ++z)
     for (int y = box.min.y; y <= box.max.y; ++y)
-    for (int x = box.min.x; x <= box.max.x; ++x, ++i)
+    for (int x = box.min.x; x <= box.max.x; ++x, ++i) {
+        touch(LinearIndex(z,y,x));
         getPoint(x,y,z).setCost(v + data[i]);
+    }
 }
 void NavGrid::setCosts(const IBox_3 &box, float v)
 {
@@ -422,8 +698,100 @@ void NavGrid::setCosts(const IBox_3 &box, float v)
         throw std::invalid_argument("bounding box exceeds grid");
     for (int z = box.min.z; z <= box.max.z; ++z)
     for (int y = box.min.y; y <= box.max.y; ++y)
-    for (int x = box.min.x; x <= box.max.x; ++x)
+    for (int x = box.min.x; x <= box.max.x; ++x) {
+        touch(LinearIndex(z,y,x));
         getPoint(x,y,z).setCost(v);
+    }
+}
+
+void NavGrid::snapshot()
+{
+    if (++mSnapshot.Epoch == 0) {
+        std::fill(mSnapshot.TileEpochs.begin(), mSnapshot.TileEpochs.end(), 0);
+        mSnapshot.Epoch = 1;
+    }
+    mSnapshot.Active = true;
+    mSnapshot.Tiles.clear();
+    mSnapshot.Spacings = mSpacings;
+    mSnapshot.ClearanceValid = mClearanceValid;
+    mSnapshot.SpacingClassesSaved = false;
+    mSnapshot.SpacingClasses.clear();
+}
+void NavGrid::dropSnapshot()
+{
+    mSnapshot.Active = false;
+    mSnapshot.Tiles.clear();
+    mSnapshot.SpacingClassesSaved = false;
+    mSnapshot.SpacingClasses.clear();
+}
+
+void NavGrid::restore()
+{
+    if (!mSnapshot.Active)
+        throw std::runtime_error("NavGrid has no snapshot to restore");
+    DEBUG("Restoring " << mSnapshot.Tiles.size() << " NavGrid tiles from snapshot.");
+    for (const auto &T : mSnapshot.Tiles) {
+        const uint i0 = T.Tile * NAV_GRID_TILE_SIZE;
+        const uint i1 = std::min(i0 + NAV_GRID_TILE_SIZE, getNumPoints()) - 1;
+        std::copy(&T.Points[0], &T.Points[i1 - i0 + 1], &mPoints[i0]);
+        mTileChangeSeqs[T.Tile] = mChangeSeq;
+        mKOCounts.setTile(T.Tile, T.HasKOCounts ? T.KOCounts : 0);
+        mUserKeepouts.setTile(T.Tile, T.HasUserKeepouts ? T.UserKeepouts : 0);
+    }
+    mSpacings = mSnapshot.Spacings;
+    mClearanceValid = mSnapshot.ClearanceValid;
+    if (mSnapshot.SpacingClassesSaved)
+        mSpacingClasses = std::move(mSnapshot.SpacingClasses);
+    if (!mSnapshot.Tiles.empty())
+        mConnectivity.invalidate();
+    snapshot();
+}
+
+void NavGrid::touchAll()
+{
+    for (uint k = 0; k < mTileChangeSeqs.size(); ++k)
+        touchTile(k);
+}
+
+void NavGrid::getChangedBoxes(uint32_t &since, std::vector<IBox_3> &boxes)
+{
+    const uint N = getNumPoints();
+    for (uint k = 0; k < mTileChangeSeqs.size(); ++k) {
+        if (mTileChangeSeqs[k] <= since)
+            continue;
+        uint i0 = k * NAV_GRID_TILE_SIZE;
+        while (k + 1 < mTileChangeSeqs.size() && mTileChangeSeqs[k + 1] > since)
+            ++k;
+        const uint i1 = std::min((k + 1) * NAV_GRID_TILE_SIZE, N) - 1;
+        // Split the range by layer and cover the partial rows with whole ones.
+        while (i0 <= i1) {
+            const auto &P0 = mPoints[i0];
+            const uint end = std::min(i1, (P0.z() + 1) * mStrideZ - 1);
+            const auto &P1 = mPoints[end];
+            if (P0.y() == P1.y())
+                boxes.push_back(IBox_3(IPoint_3(P0.x(), P0.y(), P0.z()), IPoint_3(P1.x(), P1.y(), P1.z())));
+            else
+                boxes.push_back(IBox_3(IPoint_3(0, P0.y(), P0.z()), IPoint_3(mSize[0] - 1, P1.y(), P1.z())));
+            i0 = end + 1;
+        }
+    }
+    since = mChangeSeq++;
+}
+
+void NavGrid::saveTile(uint k)
+{
+    const uint i0 = k * NAV_GRID_TILE_SIZE;
+    const uint n = std::min(NAV_GRID_TILE_SIZE, getNumPoints() - i0);
+    auto &T = mSnapshot.Tiles.emplace_back();
+    T.Tile = k;
+    std::copy(&mPoints[i0], &mPoints[i0] + n, &T.Points[0]);
+    T.HasKOCounts = mKOCounts.hasTile(k);
+    if (T.HasKOCounts)
+        std::copy(mKOCounts.getTile(k), mKOCounts.getTile(k) + NAV_GRID_TILE_SIZE, &T.KOCounts[0]);
+    T.HasUserKeepouts = mUserKeepouts.hasTile(k);
+    if (T.HasUserKeepouts)
+        std::copy(mUserKeepouts.getTile(k), mUserKeepouts.getTile(k) + NAV_GRID_TILE_SIZE, &T.UserKeepouts[0]);
+    mSnapshot.TileEpochs[k] = mSnapshot.Epoch;
 }
 
 
@@ -498,7 +866,7 @@ std::string NavGrid::str(const IBox_3 *box) const
     for (int y = y1 - 1; y >= y0; --y) {
         ss << std::dec << std::setw(2) << y;
         for (uint x = x0; x < x1; ++x) {
-            const uint n = getPoint(x,y,0).getKOCounts()._RouteTracks;
+            const uint n = getKOCounts(getPoint(x,y,0))._RouteTracks;
             ss << '|' << std::hex << std::setw(2) << uint(getPoint(x,y,0).getFlags()) << ' ';
             if (n)
                 ss << n;
@@ -511,19 +879,43 @@ std::string NavGrid::str(const IBox_3 *box) const
 
 PyObject *NavGrid::getPy(const IBox_3 &box) const
 {
-    const uint N = box.volume();
-    const uint W = box.w();
-    const uint H = box.h();
-    const uint D = box.d();
-    uint16_t *data = (uint16_t *)std::malloc(N * sizeof(uint16_t));
-    for (int Z = 0, z = box.min.z; z <= box.max.z; ++Z, ++z) {
-    for (int Y = 0, y = box.min.y; y <= box.max.y; ++Y, ++y) {
-    for (int X = 0, x = box.min.x; x <= box.max.x; ++X, ++x) {
-        auto k = (W * H) * Z + W * Y + X;
-        auto i = LinearIndex(z, y, x);
-        data[k] = mPoints[i].getFlags();
-    }}}
-    return py::NPArray<uint16_t>(data, D, H, W).ownData().release();
+    auto view = const_cast<NavGrid *>(this)->getViewPy(box, NavPointField::Flags, 0);
+    if (!view)
+        return 0;
+    auto rv = PyArray_NewCopy(reinterpret_cast<PyArrayObject *>(view), NPY_CORDER);
+    Py_DECREF(view);
+    return rv;
+}
+
+/**
+ * @return A read-only (D,H,W) array of the flags (uint16) or costs (float32) of the cells in the box that aliases the grid.
+ * The array takes the reference to @owner, which must keep the grid alive (or null if the array does not outlive this call).
+ * Writes must go through setCosts() etc. so that they are saved by snapshot() and reported by getChangedBoxes().
+ */
+PyObject *NavGrid::getViewPy(const IBox_3 &box, NavPointField field, PyObject *owner)
+{
+    if (!box.valid() || !inside(box.min) || !inside(box.max)) {
+        Py_XDECREF(owner);
+        throw std::invalid_argument("bounding box must have min <= max and be inside the grid");
+    }
+    const npy_intp dims[3] = { box.d(), box.h(), box.w() };
+    const npy_intp strides[3] = { npy_intp(mStrideZ * sizeof(NavPoint)), npy_intp(mStrideY * sizeof(NavPoint)), npy_intp(sizeof(NavPoint)) };
+    auto data = reinterpret_cast<char *>(&mPoints[LinearIndex(box.min.z, box.min.y, box.min.x)]);
+    int type = NPY_UINT16;
+    if (field == NavPointField::Flags) {
+        data += NavPoint::offsetOfFlags();
+    } else {
+        data += NavPoint::offsetOfCost();
+        type = NPY_FLOAT32;
+    }
+    auto py = PyArray_New(&PyArray_Type, 3, dims, type, strides, data, 0, NPY_ARRAY_ALIGNED, 0);
+    if (!py) {
+        Py_XDECREF(owner);
+        return 0;
+    }
+    if (owner)
+        PyArray_SetBaseObject(reinterpret_cast<PyArrayObject *>(py), owner);
+    return py;
 }
 
 /**
@@ -551,17 +943,12 @@ std::string NavPoint::str(const NavGrid *grid) const
         ss << getRefPoint(grid).x() << ',' << getRefPoint(grid).y();
     ss << ',' << (uint)getLayer() << ']';
 
-    ss << " <- " << getBackDirection().str();
-    ss << " H(" << getScore() << ')';
-
     ss << " F(";
     for (uint i = 0; i <= 10; ++i)
         if (hasFlags(1 << i))
             ss << "x=PCoO|:Xst"[i];
     ss << ')';
 
-    ss << " #{" << (int)mKOCount._RouteTracks << ',' << (int)mKOCount._RouteVias << ',' << (int)mKOCount._PinTracks << ',' << (int)mKOCount._PinVias << '}';
-
     ss << " $(" << getCost() << ')';
 
     return ss.str();
@@ -592,6 +979,17 @@ void AStarCosts::reset()
     TurnPer45Degrees = 1.0f / 1024.0f;
     WrongDirection = 1.0f;
     Via = UserSettings::get().AStarViaCostFactor;
+    JumpPoints = false;
+    IndexedQueue = false;
+    Bidirectional = false;
+    Window = -1;
+    FixedWindow = false;
+    Corridor = 0;
+    CheckConnectivity = false;
+    NetTree = false;
+    Epsilon = 1.0f;
+    Anytime = false;
+    Deadline = std::chrono::system_clock::time_point::max();
     setViolationCostInf();
 }
 void AStarCosts::setPy(PyObject *py)
@@ -614,8 +1012,32 @@ void AStarCosts::setPy(PyObject *py)
         TurnPer45Degrees = tc.toDouble();
     if (auto dir = args.item("dir"))
         PreferredDirections = dir.asString();
+    if (auto jps = args.item("jps"))
+        JumpPoints = jps.asBool();
+    if (auto queue = args.item("queue")) {
+        const auto type = queue.asString();
+        if (type != "binary" && type != "indexed")
+            throw std::invalid_argument("A-star queue must be 'binary' or 'indexed'");
+        IndexedQueue = (type == "indexed");
+    }
+    if (auto bidir = args.item("bidir"))
+        Bidirectional = bidir.asBool();
+    if (auto window = args.item("window"))
+        Window = std::clamp(window.toLong(), -1L, long(std::numeric_limits<int>::max()));
+    if (auto corridor = args.item("corridor"))
+        Corridor = std::clamp(corridor.toLong(), 0L, 1024L);
+    if (auto cc = args.item("cc"))
+        CheckConnectivity = cc.asBool();
+    if (auto tree = args.item("tree"))
+        NetTree = tree.asBool();
+    if (auto eps = args.item("eps"))
+        Epsilon = eps.toDouble();
+    if (auto anytime = args.item("anytime"))
+        Anytime = anytime.asBool();
     if (WrongDirection < 1.0f)
         throw std::invalid_argument("wrong direction cost multiplier must be >= 1");
     if (Violation < 1.0f)
         throw std::invalid_argument("drc violation cost multiplier must be >= 1");
+    if (!(Epsilon >= 1.0f))
+        throw std::invalid_argument("A-star heuristic weight must be >= 1");
 }
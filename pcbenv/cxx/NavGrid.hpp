@@ -2,8 +2,13 @@
 #define GYM_PCB_NAVGRID_H
 
 #include "NavPoint.hpp"
+#include "AStarWorkspace.hpp"
+#include "NavConnectivity.hpp"
 #include "Rasterizer.hpp"
 #include "Rules.hpp"
+#include "SparseTiles.hpp"
+#include "Util/HugePageAllocator.hpp"
+#include <chrono>
 
 // FIXME: 90°-track endpoints may be brushed on by 45°-tracks. Write testcase!
 
@@ -20,6 +25,12 @@ class Connection;
  */
 constexpr const bool CanSafelyEraseOverlappingSegments = false;
 
+/**
+ * Bytes per grid cell of the arrays that are allocated for the whole grid: the NavPoint, the A* workspace node
+ * and the connected component parent (the rasterization data is only allocated where needed).
+ */
+constexpr const size_t NAV_GRID_BYTES_PER_CELL = sizeof(NavPoint) + sizeof(AStarWorkspace::Node) + sizeof(uint32_t);
+
 /**
  * This struct stores the spacing requirements the NavGrid is/should be prepared for.
  */
@@ -44,6 +55,13 @@ inline bool NavSpacings::operator==(const NavSpacings &that) const
     return Clearance == that.Clearance && TrackWidthHalf == that.TrackWidthHalf && ViaRadius == that.ViaRadius;
 }
 
+/// The NavPoint members that NavGrid::getViewPy() can expose as numpy arrays.
+enum class NavPointField
+{
+    Flags,
+    Cost
+};
+
 struct AStarCosts
 {
     float MaskedLayer;
@@ -52,12 +70,69 @@ struct AStarCosts
     float TurnPer45Degrees;
     float WrongDirection;
     std::string PreferredDirections;
+    bool JumpPoints; /**< use jump point search where costs are uniform */
+    bool IndexedQueue; /**< use an open list that updates keys instead of inserting duplicates */
+    bool Bidirectional; /**< search from both ends at once */
+    int Window; /**< margin in cells of the search window around the connection, < 0 for the whole grid */
+    bool FixedWindow; /**< fail instead of enlarging the window if there is no path inside (set by agents, not from Python) */
+    int Corridor; /**< tile size of the global route that restricts the search, 0 for none */
+    bool CheckConnectivity; /**< fail without searching if the endpoints are in different connected components */
+    bool NetTree; /**< also end on the tracks of the net's other connections at the source pin */
+    float Epsilon; /**< heuristic weight (>= 1), the path found costs at most this much more than the best one */
+    bool Anytime; /**< after finding a path with Epsilon > 1, search again with smaller weights until Deadline */
+    std::chrono::system_clock::time_point Deadline; /**< set by agents from their timeout (for the astar actions counted from the start of the action), not from Python */
     void reset();
     void setViolationCostInf() { Violation = std::numeric_limits<float>::infinity(); }
-    bool valid() const { return MaskedLayer >= 0.0f && Via >= 0.0f && Violation >= 0.0f && WrongDirection >= 0.0f; }
+    bool valid() const { return MaskedLayer >= 0.0f && Via >= 0.0f && Violation >= 0.0f && WrongDirection >= 0.0f && Epsilon >= 1.0f; }
     void setPy(PyObject *);
 };
 
+/**
+ * The keepout counts of the grid for spacings other than the current ones, so that we can switch back without re-rasterizing.
+ * Lasting changes to the tracks are applied to all of them, the pins and layout area border don't change.
+ */
+struct NavSpacingClass
+{
+    NavSpacings Spacings;
+    SparseTiles<NavKeepoutCounts> KOCounts;
+};
+
+/// The NavGrid is snapshotted in tiles of this many consecutive cells (the same as its sparse rasterization data).
+constexpr const uint NAV_GRID_TILE_SIZE = SparseTiles<NavKeepoutCounts>::TileSize;
+
+/**
+ * The contents of a tile of the NavGrid before it was first modified after a snapshot.
+ */
+struct NavGridTileCopy
+{
+    uint Tile;
+    bool HasKOCounts;
+    bool HasUserKeepouts;
+    NavPoint Points[NAV_GRID_TILE_SIZE];
+    NavKeepoutCounts KOCounts[NAV_GRID_TILE_SIZE];
+    NavUserKeepouts UserKeepouts[NAV_GRID_TILE_SIZE];
+};
+
+/**
+ * Copy-on-write snapshot of the NavGrid: taking one only starts a new epoch, and each tile is copied
+ * the first time it is modified in that epoch, so restoring only has to write back the modified tiles.
+ * The write sequence numbers are not saved, they are only compared with the current one.
+ */
+struct NavGridSnapshot
+{
+    bool Active{false};
+    uint32_t Epoch{0};
+    std::vector<uint32_t> TileEpochs; /**< The epoch in which each tile was last saved. */
+    std::vector<NavGridTileCopy> Tiles;
+    NavSpacings Spacings;
+    bool ClearanceValid{false};
+    bool SpacingClassesSaved{false};
+    std::vector<NavSpacingClass> SpacingClasses; /**< Copy of the cached spacing classes made when they first change after the snapshot. */
+};
+
+/// The grid cells are backed by transparent huge pages to reduce TLB misses in A*.
+using NavPointVector = std::vector<NavPoint, UninitializedTHPAllocator<NavPoint>>;
+
 /**
  * This is the main 3D "navigation grid" for A* where grid-based local routing happens.
  * Grid cells are represented by NavPoints owned by the NavGrid class.
@@ -79,8 +154,8 @@ public:
     void build();
     void copyFrom(const NavGrid&);
 
-    const std::vector<NavPoint>& getPoints() const { return mPoints; }
-    std::vector<NavPoint>& getPoints() { return mPoints; }
+    const NavPointVector& getPoints() const { return mPoints; }
+    NavPointVector& getPoints() { return mPoints; }
     uint getNumPoints() const { return mPoints.size(); }
 
     const NavPoint& getPoint(uint i) const { return mPoints[i]; }
@@ -92,6 +167,37 @@ public:
     NavPoint& getPoint(const IPoint_3 &v) { return getPoint(v.x, v.y, v.z); }
     NavPoint *getPoint(const Point_2&, uint z);
     NavPoint *getPoint(const Point_25 &v) { return getPoint(v.xy(), v.z()); }
+    uint getIndex(const NavPoint &P) const { return &P - mPoints.data(); }
+
+    const NavKeepoutCounts& getKOCounts(uint i) const { return mKOCounts.get(i); }
+    const NavKeepoutCounts& getKOCounts(const NavPoint &P) const { return mKOCounts.get(getIndex(P)); }
+    NavUserKeepouts& getUserKeepouts(uint i) { touch(i); return mUserKeepouts.ref(i); }
+    uint16_t& getWriteSeq(uint i) { return mWriteSeqs.ref(i); }
+    template<typename F> void forEachUserKeepouts(F f) { touchAllocated(mUserKeepouts); mUserKeepouts.forEachAllocated(f); }
+    void write(uint i, const NavRasterizeParams&);
+    /// Same as write() for the n points starting at i, but vectorized.
+    void writeSpan(uint i, uint n, const NavRasterizeParams&);
+
+    /**
+     * Save the current state of the grid in O(1), see NavGridSnapshot.
+     * Only the grid is saved, restoring the tracks the grid was rasterized from is up to the caller.
+     */
+    void snapshot();
+    /// Return to the last snapshot (which remains active) by writing back the tiles modified since.
+    void restore();
+    void dropSnapshot();
+    bool hasSnapshot() const { return mSnapshot.Active; }
+    /// This must be called before modifying a NavPoint obtained from getPoint() outside of write() and the setters.
+    void touch(uint i);
+
+    /**
+     * Get boxes covering the cells modified since the change sequence number @since, which is advanced for the next call.
+     * Changes are tracked per tile, so the boxes may include unmodified cells but contiguous tiles are merged.
+     * Start with @since = 0 to get the whole grid.
+     */
+    void getChangedBoxes(uint32_t &since, std::vector<IBox_3>&);
+
+    size_t getMemoryUsage() const;
 
     const NavSpacings& getSpacings() const { return mSpacings; }
     bool setSpacings(const NavSpacings&);
@@ -116,39 +222,113 @@ public:
     void setCosts(const IBox_3&, const float *, float base);
 
     AStarCosts& getAStarCosts() { return mAStarCosts; }
+    const AStarWorkspace& getAStarWorkspace() const { return mAStarWorkspace; }
+    AStarWorkspace& getAStarWorkspace() { return mAStarWorkspace; }
     bool findPathAStar(Connection&, const AStarCosts *);
+    bool findPathAStar(Connection&, const AStarCosts *, AStarWorkspace&);
+
+    NavConnectivity& getConnectivity() { return mConnectivity; }
 
     Real sumViolationArea(const Connection&);
 
     uint16_t nextRasterSeq();
-    uint16_t nextSearchSeq();
-    uint16_t getSearchSeq() const { return mSearchSeq; }
 
     std::string str(const IBox_3 * = 0) const;
     PyObject *getPy(const IBox_3&) const;
+    PyObject *getViewPy(const IBox_3&, NavPointField, PyObject *owner);
     PyObject *getPathCoordinatesNumpy(const Track&) const;
 
     int getDirectionStride(GridDirection d) const { assert(d.n() <= 9); return mDirectionStride[d.n()]; }
 
 private:
     PCBoard &mPCB;
-    std::vector<NavPoint> mPoints;
+    NavPointVector mPoints;
+    SparseTiles<NavKeepoutCounts> mKOCounts; /**< Rasterization data is only needed when writing, so it is not in the NavPoints A* reads. */
+    SparseTiles<uint16_t> mWriteSeqs; /**< Most cells are never covered by a keepout, so these are allocated on write. */
+    SparseTiles<NavUserKeepouts> mUserKeepouts;
     NavSpacings mSpacings;
+    bool mClearanceValid{false}; /**< Whether mKOCounts are those for mSpacings (not before the first setSpacings()). */
+    std::vector<NavSpacingClass> mSpacingClasses; /**< Most recently used first. */
+    bool mWritingSpacingClass{false}; /**< Only write the KO counts of a cached spacing class. */
     int mDirectionStride[10]; /**< We use these to look up the addresses of neighbours in the grid because NavPoint doesn't have edge pointers (to save space). */
     AStarCosts mAStarCosts;
-    uint16_t mSearchSeq{0}; /**< To mark nodes already visited during an instance of A-star. */
+    AStarWorkspace mAStarWorkspace; /**< Used by findPathAStar() if no other workspace is passed. */
+    NavConnectivity mConnectivity{*this};
     uint16_t mRasterSeq{0}; /**< To mark nodes already written during a rasterization pass. */
+    NavGridSnapshot mSnapshot;
+    std::vector<uint32_t> mTileChangeSeqs; /**< The value of mChangeSeq when each tile was last modified. */
+    uint32_t mChangeSeq{1};
 
 private:
     void initDirectionStrides();
+    void buildPoints(uint numRows, uint minRows);
     void initEdges(NavPoint&, const IPoint_3&);
     void rasterizeFootprints();
     void rasterizeClearanceAreas();
     void rasterize(const AShape *, uint Z0, uint Z1, const NavRasterizeParams&);
-    void resetSearchSeq();
     void resetRasterSeq();
+    void resetKO();
+    void updateClearanceFlags(const SparseTiles<NavKeepoutCounts> &before);
+    void rasterizeSpacingClasses(const Connection&, const NavRasterizeParams&);
+    void touchTile(uint k);
+    void touchAll();
+    template<typename T> void touchAllocated(const SparseTiles<T>&);
+    void saveTile(uint k);
+    void saveSpacingClasses();
 };
 
+/**
+ * Without KO counts to add, writing is idempotent and we need neither the counts nor the write sequence numbers of the tile.
+ */
+inline void NavGrid::write(uint i, const NavRasterizeParams &params)
+{
+    if (mWritingSpacingClass) {
+        auto &seq = mWriteSeqs.ref(i);
+        if (seq != params.WriteSeq && !(mPoints[i].getFlags() & params.IgnoreMask)) {
+            seq = params.WriteSeq;
+            mKOCounts.ref(i).add(params.KOCount);
+        }
+        return;
+    }
+    touch(i);
+    if (params.KOCount.isZero()) {
+        auto KO = mKOCounts.get(i);
+        uint16_t seq = params.WriteSeq - 1;
+        mPoints[i].write(params, KO, seq);
+    } else {
+        mPoints[i].write(params, mKOCounts.ref(i), mWriteSeqs.ref(i));
+    }
+}
+
+inline void NavGrid::touch(uint i)
+{
+    touchTile(i / NAV_GRID_TILE_SIZE);
+}
+inline void NavGrid::touchTile(uint k)
+{
+    mTileChangeSeqs[k] = mChangeSeq;
+    if (mSnapshot.Active && mSnapshot.TileEpochs[k] != mSnapshot.Epoch)
+        saveTile(k);
+}
+
+inline void NavGrid::saveSpacingClasses()
+{
+    if (mSnapshot.Active && !mSnapshot.SpacingClassesSaved) {
+        mSnapshot.SpacingClasses = mSpacingClasses;
+        mSnapshot.SpacingClassesSaved = true;
+    }
+}
+
+/**
+ * Touch the tiles that have data allocated in @tiles (the others can only change through write()).
+ */
+template<typename T> void NavGrid::touchAllocated(const SparseTiles<T> &tiles)
+{
+    for (uint k = 0; k < tiles.numTiles(); ++k)
+        if (tiles.hasTile(k))
+            touchTile(k);
+}
+
 inline NavPoint& NavGrid::getPoint(uint x, uint y, uint z)
 {
     return mPoints.at(LinearIndex(z,y,x));
@@ -170,12 +350,6 @@ inline const NavPoint *NavGrid::getPoint(const Point_2 &v, uint z) const
     return inside(x,y,z) ? &getPoint(x, y, z) : 0;
 }
 
-inline uint16_t NavGrid::nextSearchSeq()
-{
-    if (mSearchSeq == 0x7fff) // 0x8000 is used to indicate that a point is on A-star's open list
-        resetSearchSeq();
-    return ++mSearchSeq;
-}
 inline uint16_t NavGrid::nextRasterSeq()
 {
     if (mRasterSeq == 0xffff)
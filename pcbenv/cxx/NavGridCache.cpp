@@ -0,0 +1,168 @@
+#include "NavGridCache.hpp"
+#include "NavGrid.hpp"
+#include "PCBoard.hpp"
+#include "Pin.hpp"
+#include "UserSettings.hpp"
+#include "Log.hpp"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr const char CacheMagic[8] = { 'P', 'C', 'B', 'N', 'A', 'V', 'G', '\0' };
+constexpr const uint32_t CacheVersion = 1;
+
+/// 64 bit FNV-1a
+class Hasher
+{
+public:
+    void add(const void *data, size_t size);
+    template<typename T> void add(T v) { static_assert(std::is_arithmetic_v<T>); add(&v, sizeof(T)); }
+    void add(const std::string &s) { add(uint64_t(s.size())); add(s.data(), s.size()); }
+    void add(const Bbox_2 &box) { add(box.xmin()); add(box.ymin()); add(box.xmax()); add(box.ymax()); }
+    void add(const AShape &S) { add(S.bbox()); add(S.unsignedArea()); add(S.str()); }
+    uint64_t get() const { return mHash; }
+private:
+    uint64_t mHash{0xcbf29ce484222325ull};
+};
+void Hasher::add(const void *data, size_t size)
+{
+    const auto *p = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; ++i)
+        mHash = (mHash ^ p[i]) * 0x100000001b3ull;
+}
+
+} // anon namespace
+
+NavGridCache::NavGridCache(const NavGrid &nav) : mNav(nav)
+{
+#if !defined(_WIN32)
+    const auto &dir = UserSettings::get().NavGridCacheDir;
+    if (dir.empty())
+        return;
+    computeKey();
+    mPath = fmt::format("{}/{:016x}.navgrid", dir, mKey);
+#endif
+}
+NavGridCache::~NavGridCache()
+{
+    unmap();
+}
+
+/**
+ * Hash everything that NavGrid::build() reads from the board.
+ */
+void NavGridCache::computeKey()
+{
+    Hasher H;
+    H.add(CacheVersion);
+    H.add(uint32_t(sizeof(NavPoint)));
+    for (uint d = 0; d < 3; ++d)
+        H.add(mNav.getSize(d));
+    H.add(mNav.EdgeLen);
+    H.add(mNav.getBbox());
+    for (const auto C : mNav.getPCB().getComponents()) {
+        H.add(C->getSingleLayer());
+        H.add(C->canRouteInside());
+        H.add(C->canPlaceViasInside());
+        H.add(*C->getShape());
+        for (const auto P : C->getPins()) {
+            H.add(P->minLayer());
+            H.add(P->maxLayer());
+            H.add(*P->getShape());
+        }
+    }
+    mKey = H.get();
+}
+
+const NavPoint *NavGridCache::map()
+{
+#if !defined(_WIN32)
+    if (!enabled())
+        return 0;
+    const int fd = open(mPath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return 0;
+    const size_t size = sizeof(Header) + mNav.getNumPoints() * sizeof(NavPoint);
+    struct stat st;
+    if (fstat(fd, &st) == 0 && size_t(st.st_size) == size) {
+        void *p = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            mMapped = p;
+            mMappedSize = size;
+        }
+    }
+    close(fd);
+    if (!mMapped) {
+        WARN("Ignoring NavGrid cache file of wrong size: " << mPath);
+        return 0;
+    }
+    const auto &H = *static_cast<const Header *>(mMapped);
+    if (std::memcmp(H.Magic, CacheMagic, sizeof(CacheMagic)) || H.Version != CacheVersion || H.PointSize != sizeof(NavPoint) || H.Key != mKey || H.NumPoints != mNav.getNumPoints()) {
+        WARN("Ignoring invalid NavGrid cache file: " << mPath);
+        unmap();
+        return 0;
+    }
+    madvise(mMapped, mMappedSize, MADV_SEQUENTIAL);
+    DEBUG("Mapped NavGrid cache file " << mPath);
+    return reinterpret_cast<const NavPoint *>(static_cast<const char *>(mMapped) + sizeof(Header));
+#else
+    return 0;
+#endif
+}
+
+void NavGridCache::unmap()
+{
+#if !defined(_WIN32)
+    if (mMapped)
+        munmap(mMapped, mMappedSize);
+#endif
+    mMapped = 0;
+    mMappedSize = 0;
+}
+
+/**
+ * Write to a temporary file and rename it so that concurrent jobs never map a partial file.
+ */
+void NavGridCache::store(const NavPoint *points, size_t numPoints)
+{
+#if !defined(_WIN32)
+    if (!enabled())
+        return;
+    std::error_code ec;
+    std::filesystem::create_directories(UserSettings::get().NavGridCacheDir, ec);
+
+    Header H;
+    std::memcpy(H.Magic, CacheMagic, sizeof(CacheMagic));
+    H.Version = CacheVersion;
+    H.PointSize = sizeof(NavPoint);
+    H.Key = mKey;
+    H.NumPoints = numPoints;
+
+    const std::string tmp = fmt::format("{}.{}.tmp", mPath, getpid());
+    {
+        std::ofstream fs(tmp, std::ios::binary);
+        fs.write(reinterpret_cast<const char *>(&H), sizeof(H));
+        fs.write(reinterpret_cast<const char *>(points), numPoints * sizeof(NavPoint));
+        if (!fs) {
+            WARN("Could not write NavGrid cache file: " << tmp);
+            std::remove(tmp.c_str());
+            return;
+        }
+    }
+    if (std::rename(tmp.c_str(), mPath.c_str())) {
+        WARN("Could not rename NavGrid cache file to: " << mPath);
+        std::remove(tmp.c_str());
+        return;
+    }
+    DEBUG("Saved NavGrid cache file " << mPath);
+#endif
+}
@@ -0,0 +1,43 @@
+#ifndef GYM_PCB_NAVGRIDCACHE_H
+#define GYM_PCB_NAVGRIDCACHE_H
+
+#include "NavPoint.hpp"
+#include <string>
+
+class NavGrid;
+
+/**
+ * A file cache of the NavPoints of freshly built NavGrids (footprint flags and edges) in UserSettings::NavGridCacheDir.
+ * Files are named after a hash of everything NavGrid::build() depends on: the grid size and resolution, and the layers,
+ * flags and shapes of the components and pins. Factory options and pruning are covered in that they change the board.
+ * A cache file is memory-mapped and only read by copying the points into the grid.
+ */
+class NavGridCache
+{
+public:
+    NavGridCache(const NavGrid&);
+    ~NavGridCache();
+    bool enabled() const { return !mPath.empty(); }
+    /// @return the cached points (getNumPoints() of them) or null if there is no valid cache file
+    const NavPoint *map();
+    void store(const NavPoint *, size_t numPoints);
+private:
+    struct Header
+    {
+        char Magic[8];
+        uint32_t Version;
+        uint32_t PointSize;
+        uint64_t Key;
+        uint64_t NumPoints;
+    };
+    const NavGrid &mNav;
+    uint64_t mKey{0};
+    std::string mPath;
+    void *mMapped{0};
+    size_t mMappedSize{0};
+
+    void computeKey();
+    void unmap();
+};
+
+#endif // GYM_PCB_NAVGRIDCACHE_H
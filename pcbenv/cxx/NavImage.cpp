@@ -102,19 +102,25 @@ template<typename chan_t> chan_t NavImage<chan_t>::getLayerMCoverage(uint d)
     static_assert(std::is_same_v<chan_t, float> || std::is_same_v<chan_t, uint8_t>);
 }
 
-template<typename chan_t> void NavImage<chan_t>::draw1To1(const NavGrid &nav)
+template<typename chan_t> void NavImage<chan_t>::draw1To1(const NavGrid &nav, const IBox_3 *box)
 {
     if (mSize[0] < nav.getSize(0) || mSize[1] < nav.getSize(1))
         throw std::runtime_error("Cannot draw NavGrid 1:1 to image of smaller size");
     if (mBbox != nav.getBbox())
         throw std::runtime_error("draw1To1() called with differing bounding boxes");
-    for (uint y = 0; y < std::min(mSize[1], nav.getSize(1)); ++y) {
-    for (uint x = 0; x < std::min(mSize[0], nav.getSize(0)); ++x) {
+    const uint X0 = box ? box->min.x : 0;
+    const uint Y0 = box ? box->min.y : 0;
+    const uint X1 = box ? box->max.x + 1 : std::min(mSize[0], nav.getSize(0));
+    const uint Y1 = box ? box->max.y + 1 : std::min(mSize[1], nav.getSize(1));
+    for (uint y = Y0; y < Y1; ++y) {
+    for (uint x = X0; x < X1; ++x) {
+        if (box)
+            at(x,y).zero();
         for (uint z = 0; z < nav.getSize(2); ++z)
             at(x,y).addPoint(nav.getPoint(x,y,z), ZLabel(z), FullCoverage, mLayerMCoverage);
     }}
 }
-template<typename chan_t> void NavImage<chan_t>::drawDownscale(const NavGrid &nav)
+template<typename chan_t> void NavImage<chan_t>::drawDownscale(const NavGrid &nav, const IBox_3 *box)
 {
     const uint SL = nav.XIndexBounded(mBbox.xmin());
     const uint SR = nav.XIndexBounded(mBbox.xmax());
@@ -132,12 +138,18 @@ template<typename chan_t> void NavImage<chan_t>::drawDownscale(const NavGrid &na
     const uint WD = (rh >= rv) ? mSize[0] : std::min(uint(WS / ds), mSize[0]);
     const uint HD = (rh >  rv) ? std::min(uint(HS / ds), mSize[1]) : mSize[1];
 
-    DEBUG('(' << mSize[0] << 'x' << mSize[1] << ") <- (" << WS << 'x' << HS << ") r=" << ds << " targt region = (" << WD << 'x' << HD << ')');
+    if (!box)
+        DEBUG('(' << mSize[0] << 'x' << mSize[1] << ") <- (" << WS << 'x' << HS << ") r=" << ds << " targt region = (" << WD << 'x' << HD << ')');
 
     //const float cov = 1.0f / (ds * ds);
     const float McovF = NavImage<float>::getLayerMCoverage(nav.getSize(2));
-    for (uint YD = 0; YD < HD; ++YD) {
-    for (uint XD = 0; XD < WD; ++XD) {
+    // A source cell may contribute to the pixels on both sides of the one it falls into.
+    const int XD0 = box ? std::max(int(std::floor((box->min.x - int(SL)) / ds)) - 1, 0) : 0;
+    const int YD0 = box ? std::max(int(std::floor((box->min.y - int(SB)) / ds)) - 1, 0) : 0;
+    const int XD1 = box ? std::min(int(std::floor((box->max.x - int(SL)) / ds)) + 2, int(WD)) : WD;
+    const int YD1 = box ? std::min(int(std::floor((box->max.y - int(SB)) / ds)) + 2, int(HD)) : HD;
+    for (int YD = YD0; YD < YD1; ++YD) {
+    for (int XD = XD0; XD < XD1; ++XD) {
         NavPixel<float> PF;
         PF.zero();
         float cov = 0.0f;
@@ -63,8 +63,8 @@ public:
     NavPixel<chan_t>& at(uint x, uint y) { return mData[y * mSize[0] + x]; }
     const NavPixel<chan_t>& at(uint x, uint y) const { return mData[y * mSize[0] + x]; }
 
-    void draw1To1(const NavGrid&); //!< WARNING: draw1To1() does not set via channel
-    void drawDownscale(const NavGrid&);
+    void draw1To1(const NavGrid&, const IBox_3 * = 0); //!< WARNING: draw1To1() does not set via channel
+    void drawDownscale(const NavGrid&, const IBox_3 * = 0); //!< With a box, only redraw the pixels covering these grid cells.
     void drawStatic(const PCBoard&);
     void drawDynamic(const PCBoard&);
     void drawRatsNest(const PCBoard&, const bool all);
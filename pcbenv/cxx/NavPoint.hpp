@@ -4,9 +4,11 @@
 #include "Geometry.hpp"
 #include "GridDirection.hpp"
 #include "UniformGrid25.hpp"
+#include <cstddef>
 
 /// Higher-level NavGrid:
 /// Turns out this is not often useful for A* because when connections are dense it will only encounter free high-level tiles when nothing is routed.
+/// Instead, GlobalRouter uses tiles with capacities to restrict A* to a corridor.
 
 class NavGrid;
 
@@ -36,21 +38,6 @@ class NavGrid;
 #define NAV_POINT_FLAGS_ENDPOINT        0x600 // SOURCE|TARGET
 #define NAV_POINT_FLAGS_ALL             0xfff
 
-/// This class is used to keep track of whether a NavPoint has been visited in the current invocation of A*.
-/// We use a sequence number so we don't have to reset all visited nodes each time (until the sequence wraps).
-class AStarVisitStatus
-{
-public:
-    void reset() { mSeq = 0; }
-    void setOpen(uint16_t seq) { mSeq = seq; }
-    void setDone(uint16_t seq) { assert(isOpen(seq)); mSeq = seq | 0x8000; }
-    bool isSeen(uint16_t seq) const { return (mSeq & 0x7fff) == seq; }
-    bool isOpen(uint16_t seq) const { return mSeq == seq; }
-    bool isDone(uint16_t seq) const { return mSeq == (seq | 0x8000); }
-private:
-    uint16_t mSeq{0};
-};
-
 /**
  * This struct keeps track of how many routes and pins require a grid cell to be kept free.
  * We need a count, as the clearance areas of multiple tracks and pins may overlap.
@@ -69,17 +56,36 @@ struct NavKeepoutCounts
     void setRouteVias(int8_t n)   { _RouteTracks = 0; _RouteVias = n; _PinTracks = 0; _PinVias = 0; }
     void reset()                  { _RouteTracks = 0; _RouteVias = 0; _PinTracks = 0; _PinVias = 0; }
     bool isZero() const { return _all == 0; }
+    void add(const NavKeepoutCounts &d) { _RouteTracks += d._RouteTracks; _RouteVias += d._RouteVias; _PinTracks += d._PinTracks; _PinVias += d._PinVias; }
+    uint16_t getFlags() const;
     union {
         struct {
             int8_t _RouteTracks;
             int8_t _RouteVias;
             int8_t _PinTracks;
             int8_t _PinVias;
-            int16_t _User[2];
         };
-        uint64_t _all{0};
+        uint32_t _all{0};
     };
 };
+/// The CLEARANCE flags of a NavPoint with these counts.
+inline uint16_t NavKeepoutCounts::getFlags() const
+{
+    return (_RouteTracks ? NAV_POINT_FLAG_ROUTE_TRACK_CLEARANCE : 0) |
+           (_RouteVias ? NAV_POINT_FLAG_ROUTE_VIA_CLEARANCE : 0) |
+           (_PinTracks ? NAV_POINT_FLAG_PIN_TRACK_CLEARANCE : 0) |
+           (_PinVias ? NAV_POINT_FLAG_PIN_VIA_CLEARANCE : 0);
+}
+
+/**
+ * Keepout counts managed by agents (RRR uses them for present and history costs).
+ * Unlike NavKeepoutCounts they are not tied to the grid spacings.
+ */
+struct NavUserKeepouts
+{
+    int16_t _User[2]{0, 0};
+    uint16_t _UserEpoch{0}; //!< for agents that update _User lazily (RRR: history cost decay epoch of _User[1])
+};
 
 /**
  * This struct contains parameters for updating the NavGrid's costs and flags when rasterizing shapes.
@@ -108,7 +114,9 @@ inline bool NavRasterizeParams::isNoop() const
  * This class represents a cell in the 3D grid representation of the board.
  * Grid cells will be 1x1 length units as per PCBoard(UnitLengthInNanoMeters).
  * Each cell has 8 horizontal + 2 vertical edges (indexed by GridDirection), pointing to its neighbours (or null).
- * NavPoint also contains temporary data required by A*.
+ * The temporary data required by A* is kept in an AStarWorkspace.
+ * Only what A* reads is stored here, the keepout counts and write sequence numbers used by rasterization
+ * are kept in separate arrays of the NavGrid (NavGrid::getKOCounts(), NavGrid::getWriteSeq()).
  */
 class NavPoint
 {
@@ -125,9 +133,6 @@ public:
 
     Segment_25 getSegmentTo(const NavPoint &v, const UniformGrid25 *nav) const { return Segment_25(getRefPoint(nav), v.getRefPoint(nav), mLayer); }
 
-    const NavKeepoutCounts& getKOCounts() const { return mKOCount; }
-    NavKeepoutCounts& getKOCounts() { return mKOCount; }
-    void resetKO() { mKOCount.reset(); clearFlags(NAV_POINT_FLAGS_CLEARANCE); }
     bool canRoute() const { return !(mFlags & NAV_POINT_FLAGS_TRACKS_BLOCKED); }
     bool canPlaceVia() const { return !(mFlags & NAV_POINT_FLAGS_VIAS_BLOCKED); }
     bool canPlaceViaEver() const { return !(mFlags & NAV_POINT_FLAGS_VIAS_BLOCKED_P); }
@@ -138,47 +143,34 @@ public:
     uint16_t getFlags() const { return mFlags; }
     void setFlags(uint16_t mask) { mFlags |= mask; }
     void clearFlags(uint16_t mask) { mFlags &= ~mask; }
-    void saveFlags() { mFlagsSaved = mFlags; }
-    void restoreFlags() { mFlags = mFlagsSaved; }
 
-    void write(const NavRasterizeParams&);
+    void write(const NavRasterizeParams&, NavKeepoutCounts&, uint16_t &writeSeq);
+    static void writeSpan(NavPoint *, NavKeepoutCounts *, uint16_t *writeSeqs, uint n, const NavRasterizeParams&);
     void copyFrom(const NavPoint&);
 
     float getCost() const { return mCost; }
     void setCost(float cost) { mCost = cost; }
-    float getScore() const { return mScore; }
-    void setScore(float score) { mScore = score; }
-
-    NavPoint *getBackEdge(NavGrid &nav) const { return getEdge(nav, mBackDir); }
-    GridDirection getBackDirection() const { return mBackDir; }
-    void setBackDirection(GridDirection d) { mBackDir = d; }
 
     int x() const { return mRefX; }
     int y() const { return mRefY; }
     int z() const { return mLayer; }
-
-    AStarVisitStatus& getVisits() { return mVisits; }
-    const AStarVisitStatus& getVisits() const { return mVisits; }
-
-    uint16_t getWriteSeq() const { return mWriteSeq; }
-    void setWriteSeq(uint16_t v) { mWriteSeq = v; }
+    uint32_t xy() const { return uint16_t(mRefX) | (uint32_t(uint16_t(mRefY)) << 16); } //!< x and y as one key
 
     std::string str(const NavGrid *) const;
+
+    /// For numpy views of the grid (NavGrid::getViewPy()).
+    static constexpr size_t offsetOfFlags() { return offsetof(NavPoint, mFlags); }
+    static constexpr size_t offsetOfCost() { return offsetof(NavPoint, mCost); }
 private:
     int16_t mRefX;              // 0
     int16_t mRefY;              // 2
     float mCost{1.0f};          // 4
-    float mScore;               // 8
-    uint16_t mFlags{0};         // 12
-    uint16_t mFlagsSaved{0};    // 14
-    uint16_t mEdgeMask{0};      // 16
-    uint8_t mLayer;             // 18
-    GridDirection mBackDir;     // 19
-    AStarVisitStatus mVisits;   // 20
-    NavKeepoutCounts mKOCount;  // 22
-    uint16_t mWriteSeq{0};      // 30
-    // align                    // 32
+    uint16_t mFlags{0};         // 8
+    uint16_t mEdgeMask{0};      // 10
+    uint8_t mLayer;             // 12
+    // align                    // 13
 };
+static_assert(sizeof(NavPoint) == 16);
 
 inline bool NavPoint::canAddVia(const NavPoint &to) const
 {
@@ -201,19 +193,22 @@ inline void NavPoint::copyFrom(const NavPoint &nav)
     assert(mRefX == nav.mRefX && mRefY == nav.mRefY && mLayer == nav.mLayer);
     mCost = nav.mCost;
     mFlags = nav.mFlags;
-    mKOCount = nav.mKOCount;
 }
 
-inline void NavPoint::write(const NavRasterizeParams &data)
+/**
+ * @param KO The keepout counts of this point.
+ * @param writeSeq The write sequence number of this point.
+ */
+inline void NavPoint::write(const NavRasterizeParams &data, NavKeepoutCounts &KO, uint16_t &writeSeq)
 {
-    if ((mWriteSeq == data.WriteSeq) || (mFlags & data.IgnoreMask))
+    if ((writeSeq == data.WriteSeq) || (mFlags & data.IgnoreMask))
         return;
-    mWriteSeq = data.WriteSeq;
+    writeSeq = data.WriteSeq;
     mFlags &= ~NAV_POINT_FLAGS_CLEARANCE;
-    if (mKOCount._RouteTracks += data.KOCount._RouteTracks) mFlags |= NAV_POINT_FLAG_ROUTE_TRACK_CLEARANCE;
-    if (mKOCount._RouteVias += data.KOCount._RouteVias)     mFlags |= NAV_POINT_FLAG_ROUTE_VIA_CLEARANCE;
-    if (mKOCount._PinTracks += data.KOCount._PinTracks)     mFlags |= NAV_POINT_FLAG_PIN_TRACK_CLEARANCE;
-    if (mKOCount._PinVias += data.KOCount._PinVias)         mFlags |= NAV_POINT_FLAG_PIN_VIA_CLEARANCE;
+    if (KO._RouteTracks += data.KOCount._RouteTracks) mFlags |= NAV_POINT_FLAG_ROUTE_TRACK_CLEARANCE;
+    if (KO._RouteVias += data.KOCount._RouteVias)     mFlags |= NAV_POINT_FLAG_ROUTE_VIA_CLEARANCE;
+    if (KO._PinTracks += data.KOCount._PinTracks)     mFlags |= NAV_POINT_FLAG_PIN_TRACK_CLEARANCE;
+    if (KO._PinVias += data.KOCount._PinVias)         mFlags |= NAV_POINT_FLAG_PIN_VIA_CLEARANCE;
     mFlags = (mFlags & data.FlagsAnd) | data.FlagsOr;
 }
 
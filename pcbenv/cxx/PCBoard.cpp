@@ -435,23 +435,77 @@ void PCBoard::finiPathfindingForNet(const Connection &X)
 
 void PCBoard::initPathfindingFor(const Connection &X)
 {
+    // The connected components don't need to know about changes that finiPathfindingFor() reverts.
+    getNavGrid().getConnectivity().suspend();
     if (X.hasNet())
         initPathfindingForNet(X);
-    if (X.hasTracks() && X.getTrack(0).isRasterized())
+    if (X.hasTracks() && X.getTrack(0).isRasterized()) {
+        getNavGrid().getConnectivity().invalidate();
         unrasterizeTracks(X);
+    }
 }
 void PCBoard::finiPathfindingFor(const Connection &X)
 {
     if (X.hasNet())
         finiPathfindingForNet(X);
+    getNavGrid().getConnectivity().resume();
     // caller has to rasterize track
 }
 
+/**
+ * The grid cells around an endpoint that initPathfindingFor() and A-star may unblock, plus a border of 1 cell.
+ */
+IBox_3 PCBoard::getPathfindingArea(const Connection &X, bool target) const
+{
+    const auto &nav = getNavGrid();
+    const auto &v = target ? X.target() : X.source();
+    const Pin *T = target ? X.targetPin() : X.sourcePin();
+    Bbox_2 box(v.x(), v.y(), v.x(), v.y());
+    if (T) {
+        Bbox_2 pins = T->getBbox();
+        if (T->compound())
+            for (const auto *P : *T->compound())
+                pins += P->getBbox();
+        const Real ex = std::max(nav.getSpacings().getExpansionForTracks(T->getClearance()), nav.getSpacings().getExpansionForVias(T->getClearance()));
+        box += Bbox_2(pins.xmin() - ex, pins.ymin() - ex, pins.xmax() + ex, pins.ymax() + ex);
+        if (T->getParent() && !T->getParent()->canRouteInside())
+            box += T->getParent()->getBbox();
+    }
+    auto B = nav.getBox(box);
+    B.min.x = std::max(B.min.x - 1, 0);
+    B.min.y = std::max(B.min.y - 1, 0);
+    B.max.x = std::min(B.max.x + 1, int(nav.getSize(0)) - 1);
+    B.max.y = std::min(B.max.y + 1, int(nav.getSize(1)) - 1);
+    return B;
+}
+/**
+ * A path has to leave the area around the source that initPathfindingFor() may unblock through a cell that is free without it,
+ * and reach the area around the target the same way, so the two need to share a connected component.
+ */
+bool PCBoard::mayConnect(const Connection &X, const AStarCosts *costs)
+{
+    const auto &C = costs ? *costs : getNavGrid().getAStarCosts();
+    if (!C.CheckConnectivity || !std::isinf(C.Violation))
+        return true;
+    // Tracks of other connections on the same pins are unrasterized by initPathfindingFor() and can lead anywhere.
+    for (const Pin *T : { X.sourcePin(), X.targetPin() })
+        if (T)
+            for (auto Y : T->connections())
+                if (Y != &X && Y->hasTracks() && Y->getTrack(0).isRasterized())
+                    return true;
+    return getNavGrid().getConnectivity().mayConnect(getPathfindingArea(X, false), getPathfindingArea(X, true));
+}
+
 bool PCBoard::runPathFinding(Connection &X, Connection *ref, const AStarCosts *costs)
 {
     getNavGrid().setSpacings(NavSpacings(X));
     if (!ref)
         ref = &X;
+    if (ref == &X && !X.hasTracks() && !mayConnect(X, costs)) {
+        DEBUG("A* skipped for " << X.name() << ", endpoints are not connected.");
+        getNavGrid().getAStarWorkspace().getResult().reset();
+        return false;
+    }
     // FIXME: Having to rasterize objects before routing is not very elegant.
     initPathfindingFor(*ref);
     auto rv = getNavGrid().findPathAStar(X, costs);
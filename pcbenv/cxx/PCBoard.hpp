@@ -5,6 +5,7 @@
 #include "Units.hpp"
 #include "Geometry.hpp"
 #include <map>
+#include <memory>
 #include <vector>
 #include <future>
 #include <shared_mutex>
@@ -39,7 +40,7 @@ class NavTriangulation;
 /**
  * This class represents the printed circuit board.
  */
-class PCBoard
+class PCBoard : public std::enable_shared_from_this<PCBoard>
 {
 public:
     PCBoard(const Nanometers UnitLength = Nanometers(100000.0));
@@ -100,6 +101,11 @@ public:
     void initPathfindingFor(const Connection&);
     void finiPathfindingFor(const Connection&);
 
+    /**
+     * Returns false if A-star cannot possibly find a path for the connection as per the grid's connected components.
+     */
+    bool mayConnect(const Connection&, const AStarCosts *);
+
     void add(Component&);
     void add(Net&);
     Component *remove(Component&);
@@ -226,6 +232,7 @@ private:
 
 private:
     void rebuildBVH();
+    IBox_3 getPathfindingArea(const Connection&, bool target) const;
     void removedLayersUpdate(uint removedZMin, uint removedZMax);
 };
 
@@ -144,4 +144,21 @@ Action::Result SetRouteGuard::undoAs(Agent &A)
     return Action::Result();
 }
 
+Action::Result GridSnapshot::performAs(Agent &A, PyObject *arg)
+{
+    NavGrid &nav = A.getPCB()->getNavGrid();
+    const auto op = py::Object(arg).asString("grid_snapshot: expected \"save\", \"restore\" or \"drop\"");
+    if (op == "save")
+        nav.snapshot();
+    else if (op == "restore")
+        nav.restore();
+    else if (op == "drop")
+        nav.dropSnapshot();
+    else
+        throw std::invalid_argument("grid_snapshot: expected \"save\", \"restore\" or \"drop\"");
+    A.countActions(mActionCountIncrement);
+    A.getPCB()->setChanged(PCB_CHANGED_NAV_GRID);
+    return Action::Result();
+}
+
 } // namespace actions
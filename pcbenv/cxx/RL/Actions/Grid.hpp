@@ -44,6 +44,15 @@ private:
     void setArray(PyObject *);
 };
 
+/// Must be "save", "restore" or "drop" to take, return to or discard a snapshot of the grid (see NavGrid::snapshot()).
+/// Only the grid is restored, not the tracks, so this is for testing that the grid returns to the same state.
+class GridSnapshot final : public Action
+{
+public:
+    GridSnapshot() : Action("grid_snapshot") { }
+    Result performAs(Agent&, PyObject *) override;
+};
+
 } // namespace actions
 
 #endif // GYM_PCB_RL_ACTIONS_GRID_H
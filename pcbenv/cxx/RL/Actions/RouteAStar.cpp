@@ -9,6 +9,8 @@ Action::Result AStarConnect::performAs(Agent &A, PyObject *arg)
 {
     if (arg)
         setArguments2(A, arg);
+    if (mCostsSet)
+        mCosts.Deadline = A.getActionDeadline();
     A.countActions(mActionCountIncrement);
     const auto PCB = A.getPCB();
     if (X->hasTracks())
@@ -23,6 +25,8 @@ Action::Result AStarToPoint::performAs(Agent &A, PyObject *arg)
 {
     if (arg)
         setArguments4(A, arg);
+    if (mCostsSet)
+        mCosts.Deadline = A.getActionDeadline();
     A.countActions(mActionCountIncrement);
     const auto PCB = A.getPCB();
     Connection Y(*X, mPoint[0], mPoint[1]);
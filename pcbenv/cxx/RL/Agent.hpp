@@ -92,6 +92,8 @@ public:
 
     void startTimer();
     bool hasTimerExpired() const;
+    std::chrono::system_clock::time_point getTimeoutPoint() const { return mTimeoutPoint; }
+    std::chrono::system_clock::time_point getActionDeadline() const; //!< the timeout counted from now, for single actions
     void resetActionCount();
     void resetActionLimit();
     void countActions(int);
@@ -185,6 +187,12 @@ inline void Agent::startTimer()
     else
         mTimeoutPoint = std::chrono::system_clock::time_point::max();
 }
+inline std::chrono::system_clock::time_point Agent::getActionDeadline() const
+{
+    if (!mTimeoutUSecs)
+        return std::chrono::system_clock::time_point::max();
+    return std::chrono::system_clock::now() + std::chrono::microseconds(mTimeoutUSecs);
+}
 inline bool Agent::hasTimerExpired() const
 {
     return std::chrono::system_clock::now() >= mTimeoutPoint;
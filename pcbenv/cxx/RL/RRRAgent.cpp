@@ -6,7 +6,12 @@
 #include "Track.hpp"
 #include "Via.hpp"
 #include "Net.hpp"
+#include "Clone.hpp"
+#include "RL/State/DRCheck.hpp"
+#include "Util/PCBItemSets.hpp"
 #include "RasterizerMidpoint.hpp"
+#include <array>
+#include <atomic>
 
 RRRAgent::RRRAgent() : Agent("rrr")
 {
@@ -21,14 +26,27 @@ bool RRRAgent::_run()
 {
     if (!init())
         return false;
+    if (mNumStarts > 1)
+        iterateMultiStart();
+    else
+        iterate();
+    mProgress = 1.0f;
+    mScore = postroute();
+    if (mStats.shouldAdd(mScore))
+        mStats.add(ResultRecord(*this, mScore));
+    return mScore.Success;
+}
+
+void RRRAgent::iterate()
+{
     for (mIteration = 0; mIteration < mMaxIterations && !hasTimerExpired(); ++mIteration) {
         DEBUG("RRR iteration " << mIteration);
         reroutePolicy();
         mProgress = float(mIteration) / mMaxIterations;
-        mScore.Success = rerouteHistoryOneByOne();
+        mScore.Success = canRerouteInBatches() ? rerouteHistoryInBatches() : rerouteHistoryOneByOne();
         if (mErrorState)
             break;
-        mScore = checkRouting();
+        mScore = checkRouting(mScore.Success);
         INFO("Iteration " << mIteration << ": score " << mScore.R << " success=" << mScore.Success);
         if (mScoreMax.Success || mCheckStagnationBeforeSuccess)
             mIterationsStagnant++;
@@ -41,21 +59,132 @@ bool RRRAgent::_run()
         if ((mIteration + 1) >= mMinIterations && mIterationsStagnant >= mMaxIterationsStagnant)
             break;
     }
-    mProgress = 1.0f;
-    mScore = postroute();
-    if (mStats.shouldAdd(mScore))
-        mStats.add(ResultRecord(*this, mScore));
-    return mScore.Success;
+}
+
+/**
+ * Create the agent for start k > 0 on a clone of the board (which must have this agent's connections unrouted).
+ * Starts differ in their random connection order and cycle the history cost increment through 1, 2 and 1/2 times ours.
+ */
+std::unique_ptr<RRRAgent> RRRAgent::createStart(uint k, std::map<const Connection *, Connection *> &clonedConnections)
+{
+    CloneEnv env(*mPCB);
+    std::shared_ptr<PCBoard> PCB(mPCB->clone(env));
+    clonedConnections = env.X;
+
+    auto A = std::make_unique<RRRAgent>();
+    A->setPCB(PCB);
+    A->setRewardFn(getRewardFn().clone());
+    std::set<Connection *> X;
+    for (auto X0 : mConnections)
+        X.insert(env.X.at(X0));
+    A->setManagedConnections(X);
+    A->getStepLock().setGranularity(0);
+
+    A->mMinIterations = mMinIterations;
+    A->mMaxIterations = mMaxIterations;
+    A->mMaxIterationsStagnant = mMaxIterationsStagnant;
+    A->mCheckStagnationBeforeSuccess = mCheckStagnationBeforeSuccess;
+    A->mRandomizeOrder = mRandomizeOrder;
+    A->mIncremental = mIncremental;
+    A->mConflictDriven = mConflictDriven;
+    A->mScoreOverlapFree = mScoreOverlapFree;
+    A->mHistoryCostDecay = mHistoryCostDecay;
+    A->mHistoryCostIncrement = mHistoryCostIncrement * std::array<float, 3>{ 1.0f, 2.0f, 0.5f }[k % 3];
+    A->mHistoryCostMaxIncrements = mHistoryCostMaxIncrements;
+    A->mAStarCosts = mAStarCosts;
+    A->RNG.seed(RNG() + k);
+    return A;
+}
+
+/**
+ * Run mNumStarts independent RRR starts, the first one on our board and the others on clones, on up to mNumThreads threads.
+ * Each start reroutes one by one. The best result of all starts becomes our mScoreMax and mScoreMaxTracks,
+ * the best result of each is recorded in the stats.
+ */
+void RRRAgent::iterateMultiStart()
+{
+    const uint n = mNumStarts;
+    std::vector<std::unique_ptr<RRRAgent>> starts(n);
+    std::vector<std::map<const Connection *, Connection *>> clonedConnections(n);
+    for (uint k = 1; k < n; ++k)
+        starts[k] = createStart(k, clonedConnections[k]);
+    INFO("RRR: running " << n << " starts on " << std::min(mNumThreads, n) << " threads");
+
+    std::atomic<uint> next{1};
+    std::exception_ptr error;
+    std::mutex errorLock;
+    const auto deadline = getTimeoutPoint();
+    auto work = [&]() {
+        for (uint k = next++; k < n; k = next++) {
+            try {
+                auto &A = *starts[k];
+                if (deadline != std::chrono::system_clock::time_point::max())
+                    A.setTimeout(std::max<int64_t>(1, std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::system_clock::now()).count()));
+                A.init();
+                A.iterate();
+                INFO("RRR: start " << k << " score " << A.mScoreMax.R << " success=" << A.mScoreMax.Success);
+            } catch (...) {
+                std::lock_guard lock(errorLock);
+                if (!error)
+                    error = std::current_exception();
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (uint t = 1; t < std::min(mNumThreads, n); ++t)
+        threads.emplace_back(work);
+    try {
+        iterate();
+    } catch (...) {
+        std::lock_guard lock(errorLock);
+        if (!error)
+            error = std::current_exception();
+    }
+    INFO("RRR: start 0 score " << mScoreMax.R << " success=" << mScoreMax.Success);
+    if (error)
+        next = n;
+    work();
+    for (auto &T : threads)
+        T.join();
+    if (error)
+        std::rethrow_exception(error);
+
+    mStats.Starts.emplace_back(*this, mScoreMax);
+    for (uint k = 1; k < n; ++k)
+        mStats.Starts.emplace_back(*starts[k], starts[k]->mScoreMax);
+    for (uint k = 1; k < n; ++k) {
+        const auto &A = *starts[k];
+        if (!(A.mScoreMax > mScoreMax) || A.mScoreMaxTracks.size() != mConnections.size())
+            continue;
+        std::map<const Connection *, uint> index;
+        for (uint i = 0; i < A.mConnections.size(); ++i)
+            index[A.mConnections[i]] = i;
+        mScoreMaxTracks.clear();
+        for (auto X : mConnections)
+            mScoreMaxTracks.push_back(A.mScoreMaxTracks.at(index.at(clonedConnections[k].at(X))));
+        mScoreMax = A.mScoreMax;
+        INFO("RRR: using result of start " << k);
+    }
 }
 
 bool RRRAgent::init()
 {
     startTimer();
+    mAStarCosts.Deadline = getTimeoutPoint(); // for anytime A*
     mPostrouteStage = false;
     mErrorState = false;
     mIterationsStagnant = 0;
     mScore = Action::Result(-std::numeric_limits<Reward>::infinity(), false);
     mScoreMax = mScore;
+    resetReplans();
+    if (mIncremental)
+        mStats.I64["ReusedPaths"] = 0;
+    if (mNumThreads > 1)
+        mStats.I64["WindowMisses"] = 0;
+    mConflicts.clear();
+    mClearanceUnchecked.clear();
+    mClearanceUnchecked.insert(mConnections.begin(), mConnections.end());
+    mHistoryEpoch = 0;
     const auto W = mConnections[0]->defaultTraceWidth();
     const auto C = mConnections[0]->clearance();
     mConnectionOrder.clear();
@@ -86,16 +215,54 @@ bool RRRAgent::routeHistoryAll()
     return rv;
 }
 
-bool RRRAgent::rerouteHistoryOneByOne()
+void RRRAgent::prepareRerouteHistory()
 {
     decayHistoryCosts(mHistoryCostDecay);
+    trimCostLog();
 
     if (mRandomizeOrder) // don't shuffle mConnections as it must match with mSavedTracks
         std::shuffle(mConnectionOrder.begin(), mConnectionOrder.end(), RNG);
+    selectConflicts();
+}
+
+/**
+ * Select the connections to reroute: all of them, or in conflict-driven mode those whose tracks overlap others
+ * and those whose tracks (with clearance) intersect the bounding box of an overlap.
+ * Connections that are not rerouted had no overlap when they were rasterized, and any track that overlapped them since recorded it.
+ */
+void RRRAgent::selectConflicts()
+{
+    mRerouteOrder.clear();
+    if (!mConflictDriven || mConflicts.size() < mConnections.size()) {
+        mRerouteOrder = mConnectionOrder;
+        return;
+    }
+    const NavGrid &nav = mPCB->getNavGrid();
+    std::vector<IBox_3> boxes;
+    for (const auto &I : mConflicts)
+        if (I.second.Count)
+            boxes.push_back(I.second.Box);
+    for (auto i : mConnectionOrder) {
+        const auto X = mConnections[i];
+        bool select = !X->hasTracks() || mConflicts[X].Count;
+        if (!select && !boxes.empty()) {
+            const auto A = nav.getBox(X->getTrack(0).bbox(nav.getSpacings().getExpansionForTracks(X->clearance())));
+            for (uint k = 0; k < boxes.size() && !select; ++k)
+                select = A.min.x <= boxes[k].max.x && boxes[k].min.x <= A.max.x && A.min.y <= boxes[k].max.y && boxes[k].min.y <= A.max.y;
+        }
+        if (select)
+            mRerouteOrder.push_back(i);
+    }
+    DEBUG("RRR: rerouting " << mRerouteOrder.size() << " of " << mConnections.size() << " connections");
+}
+
+bool RRRAgent::rerouteHistoryOneByOne()
+{
+    prepareRerouteHistory();
 
     bool rv = true;
     try {
-        for (auto i : mConnectionOrder)
+        for (auto i : mRerouteOrder)
             if (!rerouteHistory(*mConnections[i]))
                 rv = false;
     } catch (const std::runtime_error &e) {
@@ -105,6 +272,196 @@ bool RRRAgent::rerouteHistoryOneByOne()
     return rv;
 }
 
+/**
+ * Batches only give the same result as rerouting one by one if each search stays inside its window.
+ * The net tree makes a search depend on the net's other tracks.
+ */
+bool RRRAgent::canRerouteInBatches() const
+{
+    if (mNumThreads <= 1 || mNumStarts > 1)
+        return false;
+    if (mAStarCosts.Window < 0 || mAStarCosts.NetTree) {
+        if (mIteration == 0)
+            WARN("RRR: parallel rerouting requires an A-star search window and no net tree, rerouting one by one.");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * The cells that rerouting a connection reads or writes if the search does not leave its window:
+ * the window plus the clearance areas of the tracks, vias and pins inside it, on all layers.
+ * Returns the whole grid if the net's other tracks on its pins are rasterized (initPathfindingFor() unrasterizes them).
+ */
+IBox_3 RRRAgent::getRerouteArea(const Connection &X) const
+{
+    const NavGrid &nav = mPCB->getNavGrid();
+    const IPoint_3 last(nav.getSize(0) - 1, nav.getSize(1) - 1, nav.getSize(2) - 1);
+    const NavSpacings S(X);
+    Real ex = std::max(S.getExpansionForTracks(X.clearance()), S.getExpansionForVias(X.clearance()));
+    for (const Pin *T : { X.sourcePin(), X.targetPin() }) {
+        if (!T)
+            continue;
+        ex = std::max(ex, std::max(S.getExpansionForTracks(T->getClearance()), S.getExpansionForVias(T->getClearance())));
+        for (auto Y : T->connections())
+            if (Y != &X && Y->hasTracks() && Y->getTrack(0).isRasterized())
+                return IBox_3(IPoint_3(0, 0, 0), last);
+    }
+    const int e = mAStarCosts.Window + int(std::ceil(ex / nav.EdgeLen)) + 2;
+    auto box = nav.getBox(X.bboxAroundComps());
+    box.min = IPoint_3(std::max(box.min.x - e, 0), std::max(box.min.y - e, 0), 0);
+    box.max = IPoint_3(std::min(box.max.x + e, last.x), std::min(box.max.y + e, last.y), last.z);
+    return box;
+}
+
+/**
+ * Reroute the connections in batches whose reroute areas are disjoint, searching the connections of a batch in parallel.
+ * A connection may only be moved ahead of connections it does not interact with, so as long as every search finds a path
+ * inside its window, the result is the same as rerouting one by one.
+ * A search that has to leave its window is repeated after the rest of its batch is rasterized, so it sees the later
+ * connections of the batch on their new tracks instead of their old ones, and the result can differ (counted as WindowMisses).
+ */
+bool RRRAgent::rerouteHistoryInBatches()
+{
+    prepareRerouteHistory();
+
+    const uint maxBatchSize = mNumThreads * 4;
+    const uint maxLookahead = mNumThreads * 16;
+    auto overlap = [](const IBox_3 &A, const std::vector<IBox_3> &boxes) {
+        for (const auto &B : boxes)
+            if (A.min.x <= B.max.x && B.min.x <= A.max.x && A.min.y <= B.max.y && B.min.y <= A.max.y)
+                return true;
+        return false;
+    };
+    bool rv = true;
+    try {
+        std::vector<uint> pending = mRerouteOrder;
+        std::vector<uint> rest;
+        std::vector<uint> batch;
+        std::vector<IBox_3> taken;
+        std::vector<IBox_3> skipped;
+        while (!pending.empty() && !mErrorState) {
+            batch.clear();
+            rest.clear();
+            taken.clear();
+            skipped.clear();
+            const NavSpacings S(*mConnections[pending[0]]);
+            for (uint k = 0; k < pending.size(); ++k) {
+                const auto i = pending[k];
+                if (batch.size() < maxBatchSize && k < maxLookahead) {
+                    const auto A = getRerouteArea(*mConnections[i]);
+                    if (NavSpacings(*mConnections[i]) == S && !overlap(A, taken) && !overlap(A, skipped)) {
+                        batch.push_back(i);
+                        taken.push_back(A);
+                        continue;
+                    }
+                    skipped.push_back(A);
+                }
+                rest.push_back(i);
+            }
+            DEBUG("RRR: rerouting a batch of " << batch.size() << " connections");
+            if (!rerouteHistoryBatch(batch))
+                rv = false;
+            pending.swap(rest);
+        }
+    } catch (const std::runtime_error &e) {
+        ERROR(e.what());
+        mErrorState = true;
+    }
+    return rv;
+}
+
+/**
+ * Like rerouteHistory() for each connection in order, except that all the searches run at the same time,
+ * and connections whose search has to leave its window are searched again after the others are rasterized
+ * (so these can end up on other paths than in order).
+ * The grid is only modified before (unrouting, initPathfindingFor()) and after (finiPathfindingFor(), rasterizing) the searches.
+ */
+bool RRRAgent::rerouteHistoryBatch(const std::vector<uint> &batch)
+{
+    NavGrid &nav = mPCB->getNavGrid();
+    bool rv = true;
+    std::vector<Connection *> search;
+    for (auto i : batch) {
+        auto &X = *mConnections[i];
+        DEBUG("RRR: reroute " << X.name());
+        unrouteHistory(X);
+        bool noOverlap;
+        if (mIncremental && reusePath(X, noOverlap)) {
+            if (!noOverlap)
+                rv = false;
+            continue;
+        }
+        getStepLock().wait();
+        countActions(1);
+        updateSpacings(X);
+        search.push_back(&X);
+    }
+    // Check all before preparing any so that nothing is left prepared if one fails.
+    for (auto X : search)
+        if (!mPCB->mayConnect(*X, &mAStarCosts))
+            throw std::runtime_error("route cannot be realized in reroute stage");
+    for (auto X : search)
+        mPCB->initPathfindingFor(*X);
+
+    if (mWorkspaces.size() < search.size())
+        mWorkspaces.resize(search.size());
+    AStarCosts costs = mAStarCosts;
+    costs.FixedWindow = true;
+    std::vector<uint8_t> found(search.size(), 0);
+    std::vector<std::exception_ptr> errors(search.size());
+    std::atomic<uint> next{0};
+    auto work = [&]() {
+        for (uint k = next++; k < search.size(); k = next++) {
+            try {
+                found[k] = nav.findPathAStar(*search[k], &costs, mWorkspaces[k]);
+            } catch (...) {
+                errors[k] = std::current_exception();
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (uint t = 1; t < std::min(mNumThreads, uint(search.size())); ++t)
+        threads.emplace_back(work);
+    work();
+    for (auto &T : threads)
+        T.join();
+
+    for (auto X : search)
+        mPCB->finiPathfindingFor(*X);
+    // Nothing is rasterized yet, so drop all the paths found before failing (unrouting would erase them).
+    for (uint k = 0; k < search.size(); ++k) {
+        if (!errors[k])
+            continue;
+        std::lock_guard wlock(mPCB->getLock());
+        for (auto X : search)
+            X->clearTracks();
+        mPCB->setChanged(PCB_CHANGED_ROUTES);
+        std::rethrow_exception(errors[k]);
+    }
+    for (uint k = 0; k < search.size(); ++k) {
+        if (!found[k])
+            continue;
+        auto &X = *search[k];
+        if (mIncremental)
+            saveReplan(X, mWorkspaces[k].getResult());
+        std::lock_guard wlock(mPCB->getLock());
+        if (rasterizeHistory(X))
+            rv = false;
+        mPCB->setChanged(PCB_CHANGED_ROUTES | PCB_CHANGED_NAV_GRID);
+    }
+    for (uint k = 0; k < search.size(); ++k) {
+        if (found[k])
+            continue;
+        auto &X = *search[k];
+        DEBUG("RRR: no path inside the window for " << X.name() << ", searching again");
+        ++mStats.I64["WindowMisses"];
+        if (!routeHistory(X))
+            rv = false;
+    }
+    return rv;
+}
+
 void RRRAgent::unrouteHistoryAll()
 {
     for (auto X : mConnections)
@@ -136,6 +493,7 @@ Action::Result RRRAgent::routeProperlyAll()
 Action::Result RRRAgent::postroute()
 {
     mPostrouteStage = true;
+    resetReplans();
 
     unrouteHistoryAll();
     mPCB->getNavGrid().setCosts(1.0f);
@@ -190,32 +548,105 @@ void RRRAgent::restoreTrack(uint i, Track &T)
     }
 }
 
-Action::Result RRRAgent::checkRouting()
+/**
+ * The history rasterization only expands tracks by the current spacings, so tracks that do not overlap
+ * may still be too close to pins or other nets' vias: check the actual clearances.
+ */
+/**
+ * Only the connections placed since the last check that passed can violate clearances with anything.
+ */
+bool RRRAgent::violatesClearance()
+{
+    if (mClearanceUnchecked.empty())
+        return false;
+    sreps::ClearanceCheck DRC;
+    DRC.init(*mPCB);
+    DRC.setLimit(1);
+    PCBItemSets items(0, 0, 0, &mClearanceUnchecked);
+    if (DRC.check(items) > 0)
+        return true;
+    mClearanceUnchecked.clear();
+    return false;
+}
+
+/**
+ * Route everything without overlap to score the current history state, then go back to it.
+ * Instead of unrouting and re-rasterizing all tracks, the grid is restored from a snapshot.
+ * If no tracks overlap (no cell has _User[0] > 1) and they pass the clearance check, the routing is legal and is scored as it is.
+ */
+Action::Result RRRAgent::checkRouting(bool overlapFree)
 {
+    if (overlapFree && mScoreOverlapFree && !violatesClearance()) {
+        DEBUG("RRR: No overlaps, scoring routes as they are.");
+        Action::Result res(0.0f, true, true);
+        res.R = getRewardFn()(mConnections, &res.Router);
+        if (res > mScoreMax)
+            saveTracks(mScoreMaxTracks);
+        return res;
+    }
     DEBUG("RRR: Checking routes...");
+    NavGrid &nav = mPCB->getNavGrid();
     saveTracks(mSavedTracks);
+    const uint64_t logPos = mCostLogBase + mCostLog.size();
+    nav.snapshot();
     auto res = routeProperlyAll();
     if (res > mScoreMax)
         saveTracks(mScoreMaxTracks);
-    unrouteAll();
-    restoreTracks(mSavedTracks);
+
+    getStepLock().wait();
+    std::lock_guard wlock(mPCB->getLock());
+    for (auto X : mConnections) {
+        for (auto T : X->getTracks())
+            T->resetRasterizedCount();
+        X->clearTracks();
+    }
+    nav.restore();
+    nav.dropSnapshot();
+    for (uint i = 0; i < mConnections.size(); ++i) {
+        auto &T = mSavedTracks[i];
+        if (T.empty())
+            continue;
+        T.resetRasterizedCount();
+        mConnections[i]->setTrack(T);
+    }
+    if (logPos >= mCostLogBase) // the costs are back to what they were at logPos
+        mCostLog.resize(logPos - mCostLogBase);
+    mPCB->setChanged(PCB_CHANGED_ROUTES | PCB_CHANGED_NAV_GRID);
     return res;
 }
 
+/**
+ * Apply the history cost decay of n iterations.
+ */
+static inline uint16_t decayHistoryCost(uint16_t H, uint n, float f)
+{
+    for (; n && H; --n) {
+        const uint16_t h = std::ceil(H * f);
+        if (h == H)
+            break;
+        H = h;
+    }
+    return H;
+}
+
 class PathfinderROP final : public BaseROP
 {
 private:
     NavGrid *mGrid;
 public:
     void setTarget(NavGrid &nav) { mGrid = &nav; }
-    void write(NavPoint&);
+    void write(uint index);
     void writeRangeZYX(uint Z0, uint Z1, uint Y0, uint Y1, uint X0, uint X1) override;
+    IBox_3 OverlapBox;
+    float HistCostDecay;
     float HistCostIncrementSize;
     int32_t HistCostNumIncrements;
     int32_t HistCostMaxIncrements;
     uint32_t OverlapCount{0};
     uint16_t WriteSeq;
+    uint16_t HistEpoch;
     int16_t Value;
+    std::vector<RRRCostChange> *Log{0};
 };
 inline void PathfinderROP::writeRangeZYX(uint Z0, uint Z1, uint Y0, uint Y1, uint X0, uint X1)
 {
@@ -224,25 +655,38 @@ inline void PathfinderROP::writeRangeZYX(uint Z0, uint Z1, uint Y0, uint Y1, uin
         const auto I0 = mGrid->LinearIndex(Z, Y, X0);
         const auto I1 = I0 + (X1 - X0);
         for (uint i = I0; i <= I1; ++i)
-            write(mGrid->getPoint(i));
+            write(i);
     }}
 }
-inline void PathfinderROP::write(NavPoint &nav)
+inline void PathfinderROP::write(uint i)
 {
-    if (nav.getWriteSeq() == WriteSeq)
+    auto &seq = mGrid->getWriteSeq(i);
+    if (seq == WriteSeq)
         return;
-    nav.setWriteSeq(WriteSeq);
+    seq = WriteSeq;
 
-    auto &KO = nav.getKOCounts();
+    auto &nav = mGrid->getPoint(i);
+    auto &KO = mGrid->getUserKeepouts(i);
     KO._User[0] += Value;
     assert(KO._User[0] >= 0 && "probable inconsistency after spacings change");
-    if (KO._User[0] > 1)
-        OverlapCount++;
+    if (KO._User[0] > 1) {
+        if (!OverlapCount++)
+            OverlapBox = IBox_3(IPoint_3(nav.x(), nav.y(), nav.z()), IPoint_3(nav.x(), nav.y(), nav.z()));
+        OverlapBox.min = OverlapBox.min.min(IPoint_3(nav.x(), nav.y(), nav.z()));
+        OverlapBox.max = OverlapBox.max.max(IPoint_3(nav.x(), nav.y(), nav.z()));
+    }
 
+    if (KO._UserEpoch != HistEpoch) {
+        KO._User[1] = decayHistoryCost(KO._User[1], uint16_t(HistEpoch - KO._UserEpoch), HistCostDecay);
+        KO._UserEpoch = HistEpoch;
+    }
     uint16_t H = KO._User[1];
     if (Value > 0 && KO._User[0] > 1 && HistCostNumIncrements)
         KO._User[1] = H = std::min(int32_t(H) + HistCostNumIncrements, HistCostMaxIncrements);
-    nav.setCost((1.0f + H * HistCostIncrementSize) * (KO._User[0] + 1));
+    const float cost = (1.0f + H * HistCostIncrementSize) * (KO._User[0] + 1);
+    if (Log && cost != nav.getCost())
+        Log->push_back(RRRCostChange{i, nav.getCost()});
+    nav.setCost(cost);
 }
 
 bool RRRAgent::routeHistory(Connection &X)
@@ -253,8 +697,11 @@ bool RRRAgent::routeHistory(Connection &X)
     auto rv = mPCB->runPathFinding(X, 0, &mAStarCosts);
     if (!rv)
         throw std::runtime_error("route cannot be realized in reroute stage");
+    // A track joined to the net tree depends on the other tracks too, so it cannot be reused.
+    if (mIncremental && !mAStarCosts.NetTree)
+        saveReplan(X, mPCB->getNavGrid().getAStarWorkspace().getResult());
     std::lock_guard wlock(mPCB->getLock());
-    const uint ov = rasterize(X, 1, true);
+    const uint ov = rasterizeHistory(X);
     mPCB->setChanged(PCB_CHANGED_ROUTES | PCB_CHANGED_NAV_GRID);
     return ov == 0;
 }
@@ -272,41 +719,144 @@ bool RRRAgent::rerouteHistory(Connection &X)
 {
     DEBUG("RRR: reroute " << X.name());
     unrouteHistory(X);
+    bool noOverlap;
+    if (mIncremental && reusePath(X, noOverlap))
+        return noOverlap;
     bool rv = routeHistory(X);
     return rv;
 }
 
+/**
+ * Put the unrouted connection back on its previous path if that is still the one A-star would find.
+ * @return whether the path was reused, @noOverlap is then set to whether it overlaps other tracks
+ */
+bool RRRAgent::reusePath(Connection &X, bool &noOverlap)
+{
+    updateSpacings(X);
+    auto I = mReplans.find(&X);
+    if (I == mReplans.end() || !canReusePath(I->second))
+        return false;
+    DEBUG("RRR: reusing path for " << X.name());
+    ++mStats.I64["ReusedPaths"];
+    getStepLock().wait();
+    countActions(1);
+    I->second.LogPos = mCostLogBase + mCostLog.size();
+    std::lock_guard wlock(mPCB->getLock());
+    Track T = I->second.T;
+    T.resetRasterizedCount();
+    X.setTrack(T);
+    noOverlap = rasterizeHistory(X) == 0;
+    mPCB->setChanged(PCB_CHANGED_ROUTES | PCB_CHANGED_NAV_GRID);
+    return true;
+}
+
+void RRRAgent::saveReplan(const Connection &X, const AStarWorkspace::Result &res)
+{
+    auto &R = mReplans[&X];
+    R.LogPos = mCostLogBase + mCostLog.size();
+    R.Explored = res.Explored;
+    R.Path = res.Path;
+    std::sort(R.Path.begin(), R.Path.end());
+    R.T = X.getTrack(0);
+}
+
+/**
+ * The previous search result is still optimal if no cell became cheaper and no cell on its path became more expensive.
+ * A cell outside the area that the search looked at can still become cheap enough for the search to get there now,
+ * so any decrease counts.
+ * We compare against the cost at the time of the search (the first change logged since then).
+ */
+bool RRRAgent::canReusePath(const Replan &R) const
+{
+    const NavGrid &nav = mPCB->getNavGrid();
+    if (R.LogPos < mCostLogBase || !R.Explored.valid())
+        return false;
+    std::unordered_map<uint32_t, float> before;
+    for (auto i = R.LogPos - mCostLogBase; i < mCostLog.size(); ++i)
+        before.emplace(mCostLog[i].Index, mCostLog[i].Before);
+    for (const auto &[index, cost] : before) {
+        const float now = nav.getPoint(index).getCost();
+        if (now < cost || (now > cost && std::binary_search(R.Path.begin(), R.Path.end(), index)))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Drop the cost changes that no saved search needs anymore.
+ */
+void RRRAgent::trimCostLog()
+{
+    uint64_t pos = mCostLogBase + mCostLog.size();
+    for (const auto &I : mReplans)
+        pos = std::min(pos, I.second.LogPos);
+    if (pos <= mCostLogBase)
+        return;
+    mCostLog.erase(mCostLog.begin(), mCostLog.begin() + (pos - mCostLogBase));
+    mCostLogBase = pos;
+}
+void RRRAgent::resetReplans()
+{
+    mReplans.clear();
+    mCostLogBase += mCostLog.size();
+    mCostLog.clear();
+}
+
+/**
+ * The decay is applied lazily by PathfinderROP::write() for the epochs a point missed, as history costs only affect the
+ * grid costs when a point is written anyway. Only when the epoch counter is about to wrap are all points brought up to date.
+ */
 void RRRAgent::decayHistoryCosts(float f)
 {
     if (f == 1.0f)
         return;
-    for (auto &nav : mPCB->getNavGrid().getPoints()) {
-        uint16_t H = nav.getKOCounts()._User[1];
-        nav.getKOCounts()._User[1] = std::ceil(H * f);
-    }
+    if (++mHistoryEpoch != 0xffff)
+        return;
+    mPCB->getNavGrid().forEachUserKeepouts([this, f](NavUserKeepouts &KO) {
+        KO._User[1] = decayHistoryCost(KO._User[1], uint16_t(mHistoryEpoch - KO._UserEpoch), f);
+        KO._UserEpoch = 0;
+    });
+    mHistoryEpoch = 0;
 }
 
-uint RRRAgent::rasterize(const Connection &X, int8_t value, bool updateHistoryCost) const
+uint RRRAgent::rasterize(const Connection &X, int8_t value, bool updateHistoryCost, IBox_3 *overlapBox) const
 {
     NavGrid &nav = mPCB->getNavGrid();
     Rasterizer<PathfinderROP> R(nav);
     R.OP.setTarget(nav);
     R.OP.WriteSeq = nav.nextRasterSeq();
     R.OP.Value = value;
+    R.OP.HistCostDecay = mHistoryCostDecay;
+    R.OP.HistEpoch = mHistoryEpoch;
     R.OP.HistCostIncrementSize = mHistoryCostIncrement;
     R.OP.HistCostNumIncrements = updateHistoryCost ? 1 : 0;
     R.OP.HistCostMaxIncrements = mHistoryCostMaxIncrements;
+    R.OP.Log = mIncremental ? &mCostLog : 0;
     R.setExpansion(nav.getSpacings().getExpansionForTracks(X.clearance()));
     for (const auto *T : X.getTracks())
         R.rasterizeFill(*T, RASTERIZE_MASK_ALL);
+    if (overlapBox && R.OP.OverlapCount)
+        *overlapBox = R.OP.OverlapBox;
     return R.OP.OverlapCount;
 }
 
+/**
+ * Rasterize a rerouted track with history cost updates and remember its overlap for conflict-driven rerouting.
+ */
+uint RRRAgent::rasterizeHistory(Connection &X)
+{
+    mClearanceUnchecked.insert(&X);
+    auto &C = mConflicts[&X];
+    C.Count = rasterize(X, 1, true, &C.Box);
+    return C.Count;
+}
+
 void RRRAgent::updateSpacings(const Connection &X)
 {
     NavGrid &nav = mPCB->getNavGrid();
     if (!nav.setSpacings(NavSpacings(X)))
         return;
+    resetReplans(); // the costs are rewritten without logging
     nav.resetUserKeepout(0);
     if (mPostrouteStage)
         return;
@@ -347,6 +897,11 @@ void RRRAgent::initParameters()
     mParameters["history_cost_increment"] = new Parameter("History Cost Increment", [this](const Parameter &v){ setHistoryCostIncrement(v.d()); });
     mParameters["history_cost_max"] = new Parameter("History Cost Maximum Increments", [this](const Parameter &v){ setHistoryCostMaxIncrements(v.i()); });
     mParameters["randomize_order"] = new Parameter("Randomize Order", [this](const Parameter &v){ setRandomizeOrder(v.b()); });
+    mParameters["incremental"] = new Parameter("Incremental Rerouting", [this](const Parameter &v){ setIncremental(v.b()); });
+    mParameters["conflict_driven"] = new Parameter("Conflict-Driven Rerouting", [this](const Parameter &v){ setConflictDriven(v.b()); });
+    mParameters["threads"] = new Parameter("Threads", [this](const Parameter &v){ setNumThreads(v.i()); });
+    mParameters["starts"] = new Parameter("Starts", [this](const Parameter &v){ setNumStarts(v.i()); });
+    mParameters["score_overlap_free"] = new Parameter("Score Overlap-Free Routing Directly", [this](const Parameter &v){ setScoreOverlapFree(v.b()); });
 
     mParameters["min_iterations"]->setLimits(int64_t(mMinIterations), 0, std::numeric_limits<int32_t>::max());
     mParameters["max_iterations"]->setLimits(int64_t(mMaxIterations), 0, std::numeric_limits<int32_t>::max());
@@ -356,6 +911,11 @@ void RRRAgent::initParameters()
     mParameters["history_cost_increment"]->setLimits(mHistoryCostIncrement, 0.0, 1024.0);
     mParameters["history_cost_max"]->setLimits(int64_t(mHistoryCostMaxIncrements), 0, 0xfffe);
     mParameters["randomize_order"]->init(false);
+    mParameters["incremental"]->init(false);
+    mParameters["conflict_driven"]->init(false);
+    mParameters["threads"]->setLimits(int64_t(mNumThreads), 0, 1024);
+    mParameters["starts"]->setLimits(int64_t(mNumStarts), 1, 1024);
+    mParameters["score_overlap_free"]->init(true);
 }
 
 PyObject *RRRAgent::get_state(PyObject *py)
@@ -8,6 +8,17 @@
 #include "Track.hpp"
 #include "NavGrid.hpp"
 #include <random>
+#include <thread>
+#include <unordered_map>
+
+/**
+ * A grid cost change recorded during the history stage of RRR.
+ */
+struct RRRCostChange
+{
+    uint32_t Index; //!< grid point index
+    float Before;
+};
 
 /**
  * A simple automatic rip-up and reroute (RRR) agent like Pathfinder [L. McMurchie and C. Ebeling, 1995].
@@ -35,6 +46,11 @@ public:
     void setHistoryCostIncrement(float);
     void setHistoryCostMaxIncrements(int32_t);
     void setRandomizeOrder(bool);
+    void setIncremental(bool);
+    void setNumThreads(uint);
+    void setConflictDriven(bool);
+    void setNumStarts(uint);
+    void setScoreOverlapFree(bool);
 
 private:
     uint mMinIterations{1};
@@ -44,22 +60,36 @@ private:
     bool mCheckStagnationBeforeSuccess{false};
     bool mRandomizeOrder{false};
     bool mPostrouteStage{false};
+    bool mIncremental{false};
+    uint mNumThreads{1};
+    bool mConflictDriven{false};
+    uint mNumStarts{1};
+    bool mScoreOverlapFree{true}; //!< score routing without overlaps as it is if it passes the clearance check
     float mHistoryCostDecay{1.0f};
     float mHistoryCostIncrement{1.0f/16.0f};
     int32_t mHistoryCostMaxIncrements{0xfffe};
     std::vector<uint> mConnectionOrder;
+    std::vector<uint> mRerouteOrder; //!< the connections to reroute in the current iteration
     std::mt19937 RNG{unsigned(std::chrono::system_clock::now().time_since_epoch().count())}; //!< for random order
     AStarCosts mAStarCosts;
 private:
     bool init();
     void initParameters();
+    void iterate();
     bool routeHistoryAll();
+    void prepareRerouteHistory();
     bool rerouteHistoryOneByOne();
+    bool rerouteHistoryInBatches();
+    bool rerouteHistoryBatch(const std::vector<uint>&);
+    bool canRerouteInBatches() const;
+    IBox_3 getRerouteArea(const Connection&) const;
     void unrouteHistoryAll();
     Action::Result routeProperlyAll();
     void unrouteAll();
     Action::Result postroute();
-    Action::Result checkRouting();
+    Action::Result checkRouting(bool overlapFree);
+    bool violatesClearance();
+    std::set<Connection *> mClearanceUnchecked; //!< connections placed since the last clearance check that passed
     void saveTracks(std::vector<Track>&);
     void restoreTracks(std::vector<Track>&);
     uint mIterationsStagnant;
@@ -70,20 +100,55 @@ private:
     bool mErrorState;
     py::ObjectRef mConnectionsPy{0}; //!< argument for reroute policy call
 
-    uint rasterize(const Connection&, int8_t value, bool updateHistoryCost) const;
+    uint rasterize(const Connection&, int8_t value, bool updateHistoryCost, IBox_3 *overlapBox = 0) const;
+    uint rasterizeHistory(Connection&);
     void decayHistoryCosts(float);
+    uint16_t mHistoryEpoch{0}; //!< number of history cost decays applied lazily (see NavUserKeepouts::_UserEpoch)
 
     void updateSpacings(const Connection&);
 
     bool routeHistory(Connection&);
     void unrouteHistory(Connection&);
     bool rerouteHistory(Connection&);
+    bool reusePath(Connection&, bool &noOverlap);
     bool route(Connection&);
     void unroute(Connection&);
     bool reroute(Connection&);
     void restoreTrack(uint i, Track&);
 
     void reroutePolicy(); //!< let Python update connection order (and selection)
+
+    /// Incremental rerouting: a connection's previous path is reused if the costs that its search depended on did not change.
+    struct Replan
+    {
+        uint64_t LogPos; //!< position in the cost change log after the search
+        IBox_3 Explored;
+        std::vector<uint32_t> Path; //!< sorted
+        Track T{Point_25(0,0,0)};
+    };
+    mutable std::vector<RRRCostChange> mCostLog; //!< written by rasterize()
+    uint64_t mCostLogBase{0}; //!< absolute position of mCostLog[0]
+    std::unordered_map<const Connection *, Replan> mReplans;
+    void saveReplan(const Connection&, const AStarWorkspace::Result&);
+    bool canReusePath(const Replan&) const;
+    void trimCostLog();
+    void resetReplans();
+
+    /// Conflict-driven rerouting: the overlap of each connection's track with others when it was last rasterized.
+    struct Conflict
+    {
+        uint Count{0}; //!< number of cells
+        IBox_3 Box; //!< bounding box of the overlapping cells, valid if Count > 0
+    };
+    std::unordered_map<const Connection *, Conflict> mConflicts;
+    void selectConflicts();
+
+    /// Parallel rerouting: connections whose reroute areas are disjoint are searched concurrently, each with its own workspace.
+    std::vector<AStarWorkspace> mWorkspaces;
+
+    /// Multi-start: independent runs on clones of the board with their own order and history cost, the best result is kept.
+    void iterateMultiStart();
+    std::unique_ptr<RRRAgent> createStart(uint k, std::map<const Connection *, Connection *> &clonedConnections);
 };
 
 inline void RRRAgent::setMinIterations(uint n)
@@ -128,5 +193,25 @@ inline void RRRAgent::setRandomizeOrder(bool b)
 {
     mRandomizeOrder = b;
 }
+inline void RRRAgent::setIncremental(bool b)
+{
+    mIncremental = b;
+}
+inline void RRRAgent::setConflictDriven(bool b)
+{
+    mConflictDriven = b;
+}
+inline void RRRAgent::setNumStarts(uint n)
+{
+    mNumStarts = std::max(n, 1u);
+}
+inline void RRRAgent::setScoreOverlapFree(bool b)
+{
+    mScoreOverlapFree = b;
+}
+inline void RRRAgent::setNumThreads(uint n)
+{
+    mNumThreads = n ? n : std::max(1u, std::thread::hardware_concurrency());
+}
 
 #endif // GYM_PCB_RRRAGENT_H
@@ -27,6 +27,7 @@ public:
     static RewardFunction *create(PyObject *);
 public:
     virtual ~RewardFunction() { }
+    virtual RewardFunction *clone() const = 0;
     virtual void setContext(const PCBoard&) { }
     virtual Reward operator()(const Connection&, RouterResult * = 0) const = 0;
     virtual Reward operator()(const std::vector<Connection *>&, RouterResult * = 0) const = 0;
@@ -41,6 +42,7 @@ class RouteLength : public RewardFunction
 public:
     static RouteLength *create(PyObject *);
     RouteLength();
+    RewardFunction *clone() const override { return new RouteLength(*this); }
     virtual void setContext(const PCBoard&) override;
     Reward operator()(const Connection&, RouterResult * = 0) const override;
     Reward operator()(const std::vector<Connection *>&, RouterResult * = 0) const override;
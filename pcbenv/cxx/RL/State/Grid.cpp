@@ -1,3 +1,4 @@
+#include "PyArray.hpp"
 #include "RL/State/Grid.hpp"
 #include "PCBoard.hpp"
 
@@ -22,4 +23,72 @@ PyObject *GridData::getPy(PyObject *args)
     return rv;
 }
 
+/**
+ * The views hold a reference to the board, so they stay valid after the environment moves on to another one.
+ * Boards that are not owned by a shared_ptr get copies instead.
+ */
+PyObject *GridView::getPy(PyObject *args)
+{
+    assert(mPCB);
+    if (!mPCB)
+        return 0;
+    IBox_3 box = getBox();
+    if (args && PyTuple_Check(args))
+        box = py::Object(args).asIBox_3();
+    auto &nav = mPCB->getNavGrid();
+    auto board = mPCB->weak_from_this().lock();
+    auto py = PyDict_New();
+    for (auto field : { NavPointField::Flags, NavPointField::Cost }) {
+        auto owner = board ? PyCapsule_New(new std::shared_ptr<PCBoard>(board), 0, [](PyObject *C) {
+            delete static_cast<std::shared_ptr<PCBoard> *>(PyCapsule_GetPointer(C, 0));
+        }) : 0;
+        auto view = nav.getViewPy(box, field, owner);
+        if (view && !board) {
+            auto copy = PyArray_NewCopy(reinterpret_cast<PyArrayObject *>(view), NPY_CORDER);
+            Py_DECREF(view);
+            view = copy;
+        }
+        py::Dict_StealItemString(py, field == NavPointField::Flags ? "flags" : "cost", view);
+    }
+    return py;
+}
+
+PyObject *AStarStats::getPy(PyObject *)
+{
+    assert(mPCB);
+    if (!mPCB)
+        return 0;
+    const auto &res = mPCB->getNavGrid().getAStarWorkspace().getResult();
+    auto py = PyDict_New();
+    if (!py)
+        return 0;
+    auto costs = PyList_New(res.Costs.size());
+    for (uint i = 0; i < res.Costs.size(); ++i)
+        PyList_SetItem(costs, i, PyFloat_FromDouble(res.Costs[i]));
+    py::Dict_StealItemString(py, "visits", PyLong_FromUnsignedLongLong(res.Visits));
+    py::Dict_StealItemString(py, "cost", PyFloat_FromDouble(res.Cost));
+    py::Dict_StealItemString(py, "costs", costs);
+    py::Dict_StealItemString(py, "path_len", PyLong_FromLong(res.Path.size()));
+    py::Dict_StealItemString(py, "corridor", (res.Corridor < 0) ? py::None() : PyBool_FromLong(res.Corridor));
+    py::Dict_StealItemString(py, "outside_corridor", PyLong_FromLong(res.OutsideCorridor));
+    return py;
+}
+
+PyObject *GridChanges::getPy(PyObject *)
+{
+    assert(mPCB);
+    if (!mPCB)
+        return 0;
+    std::vector<IBox_3> boxes;
+    mPCB->getNavGrid().getChangedBoxes(mChangeSeq, boxes);
+    auto py = PyList_New(boxes.size());
+    for (uint i = 0; i < boxes.size(); ++i) {
+        auto box = PyTuple_New(2);
+        PyTuple_SetItem(box, 0, *py::Object(boxes[i].min));
+        PyTuple_SetItem(box, 1, *py::Object(boxes[i].max));
+        PyList_SetItem(py, i, box);
+    }
+    return py;
+}
+
 } // namespace sreps
@@ -10,12 +10,40 @@ class GridData : public StateRepresentation
 public:
     void init(PCBoard&) override;
     void setBox(const IBox_3 &box) { mBox = box; }
+    const IBox_3& getBox() const { return mBox; }
     const char *name() const override { return "grid"; }
     PyObject *getPy(PyObject *members_and_box) override;
 private:
     IBox_3 mBox;
 };
 
+/// Returns numpy arrays that alias the flags and costs of the grid.
+class GridView : public GridData
+{
+public:
+    const char *name() const override { return "grid_view"; }
+    PyObject *getPy(PyObject *box) override;
+};
+
+/// Returns the statistics of the last A-star search on the board.
+class AStarStats : public StateRepresentation
+{
+public:
+    const char *name() const override { return "astar"; }
+    PyObject *getPy(PyObject *) override;
+};
+
+/// Returns the boxes of the grid cells that changed since the last call.
+class GridChanges : public StateRepresentation
+{
+public:
+    void init(PCBoard &PCB) override { StateRepresentation::init(PCB); mChangeSeq = 0; }
+    const char *name() const override { return "grid_changes"; }
+    PyObject *getPy(PyObject *) override;
+private:
+    uint32_t mChangeSeq{0};
+};
+
 } // namespace sreps
 
 #endif // GYM_PCB_RL_STATE_GRID_H
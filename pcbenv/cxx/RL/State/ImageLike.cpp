@@ -23,8 +23,14 @@ class ImageDownscale : public Image
 public:
     ImageDownscale(uint w, uint h) : Image(w, h) { }
     ImageDownscale(PyObject *args) : Image(args) { }
+    void init(PCBoard&) override;
     const char *name() const override { return "image_grid"; }
     PyObject *getPy(PyObject *args) override;
+private:
+    void updateGrid();
+    std::unique_ptr<NavImage<uint8_t>> mGridImage; //!< without the rats nest
+    bool mGridImage1To1{false};
+    uint32_t mGridChangeSeq{0};
 };
 
 void Image::init(PCBoard &PCB)
@@ -109,6 +115,13 @@ void Image::updateView(const Bbox_2 *vbox)
     DEBUG("Image::updateView bbox=(" << mImageBox << ") scale=" << s << " size=" << mSize.x << 'x' << mSize.y << " vbox=" << vbox);
 }
 
+void ImageDownscale::init(PCBoard &PCB)
+{
+    Image::init(PCB);
+    mGridImage.reset();
+    mGridChangeSeq = 0;
+}
+
 PyObject *ImageRasterize::getPy(PyObject *args)
 {
     assert(mPCB);
@@ -131,17 +144,41 @@ PyObject *ImageDownscale::getPy(PyObject *args)
     setParameters(args);
     if (!mLockedView)
         updateView();
-    const NavGrid &nav = mPCB->getNavGrid();
-    NavImage<uint8_t> image(std::min(uint(mSize.x), nav.getSize(0)), std::min(uint(mSize.y), nav.getSize(1)), mImageBox, nav.getSize(2));
-    setZeroSpacings();
-    if (mScaleMax >= 1.0f && image.checkFit(nav) >= 0)
-        image.draw1To1(nav);
-    else
-        image.drawDownscale(nav);
+    updateGrid();
+    NavImage<uint8_t> image(*mGridImage.get());
     image.drawRatsNest(*mPCB, false);
     return image.movePy();
 }
 
+/**
+ * Only redraw the pixels of the grid cells that changed since the last call if the view is the same.
+ */
+void ImageDownscale::updateGrid()
+{
+    NavGrid &nav = mPCB->getNavGrid();
+    setZeroSpacings();
+    std::vector<IBox_3> changes;
+    nav.getChangedBoxes(mGridChangeSeq, changes);
+
+    const uint w = std::min(uint(mSize.x), nav.getSize(0));
+    const uint h = std::min(uint(mSize.y), nav.getSize(1));
+    if (mGridImage && mGridImage->getBbox() == mImageBox && mGridImage->getSize() == IVector_3(w, h, 1)) {
+        for (const auto &box : changes) {
+            if (mGridImage1To1)
+                mGridImage->draw1To1(nav, &box);
+            else
+                mGridImage->drawDownscale(nav, &box);
+        }
+        return;
+    }
+    mGridImage = std::make_unique<NavImage<uint8_t>>(w, h, mImageBox, nav.getSize(2));
+    mGridImage1To1 = mScaleMax >= 1.0f && mGridImage->checkFit(nav) >= 0;
+    if (mGridImage1To1)
+        mGridImage->draw1To1(nav);
+    else
+        mGridImage->drawDownscale(nav);
+}
+
 void ImageRasterize::updateStatic()
 {
     const NavGrid &nav = mPCB->getNavGrid();
@@ -13,6 +13,9 @@ StateRepresentation *StateRepresentation::create(PyObject *py)
     if (name.starts_with("end")) return new sreps::ConnectionEndpoints();
     if (name == "features") return new sreps::CustomFeatures();
     if (name == "grid") return new sreps::GridData();
+    if (name == "grid_changes") return new sreps::GridChanges();
+    if (name == "grid_view") return new sreps::GridView();
+    if (name == "astar") return new sreps::AStarStats();
     if (name.starts_with("raster")) return new sreps::TrackRasterization();
     if (name == "track" || name == "track_segments") return new sreps::TrackSegments(name.ends_with("_np") || name.ends_with("numpy"));
     throw std::invalid_argument(fmt::format("invalid state representation specifier: {}", name));
@@ -47,6 +47,8 @@ PyObject *ResultCollection::getPy() const
 {
     auto res = py::Object(PyDict_New());
     res.setItem("TimeLine", py::Object::new_ListFrom(TimeLine));
+    if (!Starts.empty())
+        res.setItem("Starts", py::Object::new_ListFrom(Starts));
     res.setItem("WorstSuccess", WorstSuccess.getPy());
     res.setItem("Worst", Worst.getPy());
     for (const auto &I : F32)
@@ -28,6 +28,7 @@ struct ResultRecord
 struct ResultCollection
 {
     std::vector<ResultRecord> TimeLine;
+    std::vector<ResultRecord> Starts; //!< the best result of each start of a multi-start run
     ResultRecord WorstSuccess;
     ResultRecord Worst;
     std::map<std::string, float> F32;
@@ -51,6 +52,7 @@ inline void ResultRecord::reset(bool success, Reward r)
 inline void ResultCollection::reset()
 {
     TimeLine.clear();
+    Starts.clear();
     WorstSuccess.reset(false);
     Worst.reset(true);
     F32.clear();
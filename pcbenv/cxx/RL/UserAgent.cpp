@@ -13,6 +13,9 @@ UserAgent::UserAgent() : Agent("user")
     mSR.map[mSR.Board.name()] = &mSR.Board;
     mSR.map[mSR.EndpointsNumpy.name()] = &mSR.EndpointsNumpy;
     mSR.map[mSR.Grid.name()] = &mSR.Grid;
+    mSR.map[mSR.GridChanges.name()] = &mSR.GridChanges;
+    mSR.map[mSR.GridView.name()] = &mSR.GridView;
+    mSR.map[mSR.AStar.name()] = &mSR.AStar;
     mSR.map[mSR.Raster.name()] = &mSR.Raster;
     mSR.map[mSR.Segments.name()] = &mSR.Segments;
     mSR.map[mSR.Metrics.name()] = &mSR.Metrics;
@@ -38,6 +41,7 @@ void UserAgent::initActionsUser()
     mActionSpaceU.addAction(&mActions.UnrouteSegment);
     mActionSpaceU.addAction(&mActions.SetTrack);
     mActionSpaceU.addAction(&mActions.Lock);
+    mActionSpaceU.addAction(&mActions.Snapshot);
 }
 void UserAgent::initActionsLegacy()
 {
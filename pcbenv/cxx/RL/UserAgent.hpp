@@ -35,6 +35,7 @@ private:
         actions::UnrouteNet UnrouteNet{0};
         actions::SetTrack SetTrack{0};
         actions::LockRouted Lock;
+        actions::GridSnapshot Snapshot;
     } mActions;
     ActionSpace mActionSpaceU;
     ActionSpace mActionSpaceLegacy;
@@ -44,6 +45,9 @@ private:
         StateRepresentation None;
         sreps::WholeBoard Board;
         sreps::GridData Grid;
+        sreps::GridChanges GridChanges;
+        sreps::GridView GridView;
+        sreps::AStarStats AStar;
         sreps::ConnectionEndpoints EndpointsNumpy;
         sreps::TrackRasterization Raster;
         sreps::TrackSegments Segments{true};
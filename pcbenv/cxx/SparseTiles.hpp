@@ -0,0 +1,105 @@
+#ifndef GYM_PCB_SPARSETILES_H
+#define GYM_PCB_SPARSETILES_H
+
+#include "Defs.hpp"
+#include <memory>
+#include <vector>
+
+/**
+ * An array of n values split into tiles of 2^L consecutive elements.
+ * A tile is only allocated when one of its elements is written, until then it reads as a shared tile of default values.
+ * Use this for grid data that is only non-default near obstacles so its memory scales with the occupied area.
+ */
+template<typename T, uint L = 6> class SparseTiles
+{
+public:
+    constexpr static const uint TileSize = 1u << L;
+
+    SparseTiles() { }
+    SparseTiles(const SparseTiles &that) { *this = that; }
+    SparseTiles(SparseTiles&&) = default;
+    SparseTiles& operator=(const SparseTiles&);
+    SparseTiles& operator=(SparseTiles&&) = default;
+    void swap(SparseTiles &that) { mTiles.swap(that.mTiles); std::swap(mSize, that.mSize); }
+
+    void resize(uint n) { mSize = n; mTiles.clear(); mTiles.resize((n + TileSize - 1) >> L); }
+    uint size() const { return mSize; }
+    void clear() { for (auto &t : mTiles) t.reset(); }
+
+    const T& get(uint i) const { const auto &t = mTiles[i >> L]; return t ? t[i & (TileSize - 1)] : Default; }
+    T& ref(uint i);
+
+    uint numTiles() const { return mTiles.size(); }
+    bool hasTile(uint k) const { return !!mTiles[k]; }
+    const T *getTile(uint k) const { return mTiles[k].get(); }
+    void setTile(uint k, const T *data);
+
+    template<typename F> void forEachAllocated(F f);
+    size_t getNumAllocated() const;
+    size_t getMemoryUsage() const { return getNumAllocated() * TileSize * sizeof(T) + mTiles.capacity() * sizeof(mTiles[0]); }
+private:
+    std::vector<std::unique_ptr<T[]>> mTiles;
+    uint mSize{0};
+    inline static const T Default{};
+};
+
+template<typename T, uint L> SparseTiles<T, L>& SparseTiles<T, L>::operator=(const SparseTiles &that)
+{
+    if (&that == this)
+        return *this;
+    if (mSize != that.mSize)
+        resize(that.mSize);
+    for (uint k = 0; k < mTiles.size(); ++k) {
+        if (!that.mTiles[k]) {
+            mTiles[k].reset();
+            continue;
+        }
+        if (!mTiles[k])
+            mTiles[k].reset(new T[TileSize]);
+        std::copy(&that.mTiles[k][0], &that.mTiles[k][TileSize], &mTiles[k][0]);
+    }
+    return *this;
+}
+
+template<typename T, uint L> inline T& SparseTiles<T, L>::ref(uint i)
+{
+    auto &t = mTiles[i >> L];
+    if (!t)
+        t.reset(new T[TileSize]());
+    return t[i & (TileSize - 1)];
+}
+
+/**
+ * Copy TileSize values into tile k, or free it if data is null.
+ */
+template<typename T, uint L> void SparseTiles<T, L>::setTile(uint k, const T *data)
+{
+    if (!data) {
+        mTiles[k].reset();
+        return;
+    }
+    if (!mTiles[k])
+        mTiles[k].reset(new T[TileSize]);
+    std::copy(data, data + TileSize, &mTiles[k][0]);
+}
+
+/**
+ * Call f(T&) for all elements of the allocated tiles (the others have the default value).
+ */
+template<typename T, uint L> template<typename F> void SparseTiles<T, L>::forEachAllocated(F f)
+{
+    for (auto &t : mTiles)
+        if (t)
+            for (uint i = 0; i < TileSize; ++i)
+                f(t[i]);
+}
+
+template<typename T, uint L> size_t SparseTiles<T, L>::getNumAllocated() const
+{
+    size_t n = 0;
+    for (const auto &t : mTiles)
+        n += t ? 1 : 0;
+    return n;
+}
+
+#endif // GYM_PCB_SPARSETILES_H
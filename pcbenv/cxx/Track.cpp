@@ -771,9 +771,9 @@ bool Track::checkRasterization(const NavGrid &nav) const
 {
     if (!isRasterized())
         return false;
-    if (nav.getPoint(mStart)->getKOCounts()._RouteTracks < 1)
+    if (nav.getKOCounts(*nav.getPoint(mStart))._RouteTracks < 1)
         return false;
-    if (nav.getPoint(mEnd)->getKOCounts()._RouteTracks < 1)
+    if (nav.getKOCounts(*nav.getPoint(mEnd))._RouteTracks < 1)
         return false;
     return true;
 }
@@ -30,14 +30,17 @@ NavMesh::~NavMesh()
         ctx->glDeleteVertexArrays(1, &mVAO);
 }
 
-Color NavMesh::navColor(const NavPoint &v, uint seq)
+Color NavMesh::navColor(const NavPoint &v, const AStarWorkspace &ws)
 {
     if (v.hasFlags(NAV_POINT_FLAG_ROUTE_GUARD))
         return Color::MAGENTA;
     if (v.hasFlags(NAV_POINT_FLAG_BLOCKED_TEMPORARY | NAV_POINT_FLAG_BLOCKED_PERMANENT))
         return Color::RED;
-    if (mVisualizeAStar && v.getVisits().isSeen(seq))
-        return v.getVisits().isDone(seq) ? Color::GREEN : Color::BLUE;
+    if (mVisualizeAStar) {
+        const auto node = ws.find(v);
+        if (node && node->Visits.isSeen(ws.getSeq()))
+            return node->Visits.isDone(ws.getSeq()) ? Color::GREEN : Color::BLUE;
+    }
     if (v.hasFlags(NAV_POINT_FLAGS_TRACK_CLEARANCE))
         return Color::ORANGE;
     if (v.hasFlags(NAV_POINT_FLAGS_VIA_CLEARANCE))
@@ -70,7 +73,7 @@ void NavMesh::update(uint z)
         data[N].x = v.getRefPoint(&nav).x();
         data[N].y = v.getRefPoint(&nav).y();
         data[N].s = size;
-        data[N].c = navColor(v, nav.getSearchSeq()).ABGR8();
+        data[N].c = navColor(v, nav.getAStarWorkspace()).ABGR8();
         ++N;
     }
     mNumPoints = N;
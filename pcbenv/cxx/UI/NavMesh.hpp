@@ -10,6 +10,7 @@
 class Camera;
 class PCBoard;
 class NavPoint;
+class AStarWorkspace;
 
 class NavMesh
 {
@@ -38,7 +39,7 @@ private:
     static GLint sUniformPointSize;
     static GLint sUniformColor;
 
-    Color navColor(const NavPoint&, uint seq);
+    Color navColor(const NavPoint&, const AStarWorkspace&);
     float navSize(const NavPoint&);
 
     void createVAO();
@@ -3,7 +3,7 @@
 #include "Color.hpp"
 #include "Log.hpp"
 #include "Util/Util.hpp"
-#include "NavPoint.hpp"
+#include "NavGrid.hpp"
 #include <rapidjson/document.h>
 #include <rapidjson/schema.h>
 #include <rapidjson/stringbuffer.h>
@@ -56,10 +56,15 @@ void UserSettings::loadJSON(const std::string &data)
     if (doc.HasMember("MaxGridSize_Cells"))
         maxCells = doc["MaxGridSize_Cells"].GetUint64();
     if (doc.HasMember("MaxGridSize_MiB"))
-        maxCells = std::min(maxCells, (doc["MaxGridSize_MiB"].GetUint64() << 20) / sizeof(NavPoint));
+        maxCells = std::min(maxCells, (doc["MaxGridSize_MiB"].GetUint64() << 20) / NAV_GRID_BYTES_PER_CELL);
     if (maxCells <= std::numeric_limits<int32_t>::max())
         MaxGridCells = maxCells;
 
+    if (doc.HasMember("MaxGridSpacingClasses"))
+        MaxGridSpacingClasses = doc["MaxGridSpacingClasses"].GetUint();
+    if (doc.HasMember("NavGridCacheDir"))
+        NavGridCacheDir = doc["NavGridCacheDir"].GetString();
+
     if (doc.HasMember("AStarViaCostFactor"))
         AStarViaCostFactor = doc["AStarViaCostFactor"].GetFloat();
 
@@ -182,6 +187,8 @@ std::string UserSettings::str() const
 {
     std::stringstream ss;
     ss << "* Max grid cells: " << MaxGridCells << std::endl;
+    ss << "* Max grid spacing classes: " << MaxGridSpacingClasses << std::endl;
+    ss << "* NavGrid cache directory: " << (NavGridCacheDir.empty() ? "(disabled)" : NavGridCacheDir) << std::endl;
     ss << "* Agent timeout: " << Logger::formatDurationUS(AgentTimeoutUSecs) << std::endl;
     ss << "* A-star via cost factor: " << AStarViaCostFactor << std::endl;
     ss << "* Window size: " << UI.WindowSize[0] << 'x' << UI.WindowSize[1] << std::endl;
@@ -13,6 +13,8 @@ public:
     static const UserSettings& get() { return sInstance; }
 
     uint32_t MaxGridCells{1u << 26};
+    uint MaxGridSpacingClasses{4};
+    std::string NavGridCacheDir;
     uint64_t AgentTimeoutUSecs{0};
     float AStarViaCostFactor{1.0f};
     struct {
@@ -7,6 +7,7 @@
 #if defined(_WIN32)
 
 template<typename T> using AlignedTHPAllocator = std::allocator<T>;
+template<typename T> using UninitializedTHPAllocator = std::allocator<T>;
 
 #else
 
@@ -47,4 +48,20 @@ template<typename T> struct AlignedTHPAllocator
 template<typename T, typename U> bool operator==(const AlignedTHPAllocator<T>&, const AlignedTHPAllocator<U>&) { return true; }
 template<typename T, typename U> bool operator!=(const AlignedTHPAllocator<T>&, const AlignedTHPAllocator<U>&) { return false; }
 
+/**
+ * Like AlignedTHPAllocator, but std::vector::resize() does not initialize the new elements.
+ * The owner must construct them itself, e.g. from multiple threads so that the page faults are taken in parallel.
+ */
+template<typename T> struct UninitializedTHPAllocator : AlignedTHPAllocator<T>
+{
+    template<class U> struct rebind { using other = UninitializedTHPAllocator<U>; };
+
+    UninitializedTHPAllocator() = default;
+
+    template<class U> constexpr UninitializedTHPAllocator(const UninitializedTHPAllocator<U>&) noexcept { }
+
+    template<class U> void construct(U *) noexcept { }
+    template<class U, typename... Args> void construct(U *p, Args&&... args) { ::new(static_cast<void *>(p)) U(std::forward<Args>(args)...); }
+};
+
 #endif // _WIN32
@@ -2,6 +2,9 @@
 import unittest
 import pcbenv.tests.args as args
 import pcbenv
+import os
+import tempfile
+import numpy as np
 
 from importlib_resources import files
 
@@ -14,6 +17,18 @@ class TestCase(unittest.TestCase):
         rv = self.env.set_task({ "pdes": str(self.dsn_dir.joinpath('bm1').joinpath('bm1.unrouted.dsn')), "no_polygons": True })
         self.assertTrue(rv)
 
+    def test1_NavGridCache(self):
+        task = { "pdes": str(self.dsn_dir.joinpath('bm1').joinpath('bm1.unrouted.dsn')), "no_polygons": True }
+        with tempfile.TemporaryDirectory() as d:
+            env = pcbenv.make("pcb-v2", { 'NavGridCacheDir': d })
+            self.assertTrue(env.set_task(task))
+            grid0 = env.get_state({'grid': None})['grid']
+            self.assertTrue(any(f.endswith('.navgrid') for f in os.listdir(d)))
+            self.assertTrue(env.set_task(task))
+            grid1 = env.get_state({'grid': None})['grid']
+            self.assertTrue(np.array_equal(grid0, grid1))
+            env.close()
+
     def tearDown(self):
         self.env.close()
 
@@ -158,6 +158,41 @@ class TestCase(unittest.TestCase):
         m_two = env.get_state({'metric': ('ratsnest_crossings', {'PB6', 'AREF', 'PB5'})})['metric']
         self.assertEqual(m_two, 2)
 
+    def test8_GridChanges(self):
+        """
+        Check that updating a grid observation with the changed boxes gives the current grid.
+        """
+        env = self.env
+        CON1 = ('N$3',0)
+        g = env.get_state({'grid': None})['grid']
+        env.get_state({'grid_changes': None})
+        self.assertEqual(len(env.get_state({'grid_changes': None})['grid_changes']), 0)
+        env.step(('astar', CON1))
+        boxes = env.get_state({'grid_changes': None})['grid_changes']
+        self.assertGreater(len(boxes), 0)
+        for box in boxes:
+            (x0,y0,z0),(x1,y1,z1) = box
+            g[z0:z1+1,y0:y1+1,x0:x1+1] = env.get_state({'grid': box})['grid']
+        self.assertTrue(np.array_equal(g, env.get_state({'grid': None})['grid']))
+
+    def test9_GridView(self):
+        """
+        Check that the grid views follow changes of the grid and cannot be written to.
+        """
+        env = self.env
+        CON1 = ('N$3',0)
+        view = env.get_state({'grid_view': None})['grid_view']
+        self.assertFalse(view['flags'].flags.writeable)
+        self.assertFalse(view['cost'].flags.writeable)
+        env.step(('astar', CON1))
+        self.assertTrue(np.array_equal(view['flags'], env.get_state({'grid': None})['grid']))
+        env.step(('set_costs', (4.0, (0,0,0), (2,2,0))))
+        self.assertTrue(np.all(view['cost'][0,0:3,0:3] == 4.0))
+        env.step(('set_costs', None))
+        sub = env.get_state({'grid_view': ((1,1,0),(2,2,0))})['grid_view']
+        self.assertTrue(np.all(sub['cost'] == 1.0))
+        self.assertEqual(sub['flags'].shape, (1,2,2))
+
     def tearDown(self):
         self.env.close()
 
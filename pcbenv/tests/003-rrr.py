@@ -8,16 +8,15 @@ import pcbenv
 import pcbenv.tests.args as args
 from pcbenv.util.json_pcb import JsonPCB
 
+NETS = ['ADC'+str(i) for i in range(16)] + ['PL'+str(i) for i in range(8)] + ['SCL', 'SDA', 'RXD1', 'TXD1', 'PD7', 'N$2']
+
 class TestCase(unittest.TestCase):
     def setUp(self):
         self.env = pcbenv.make("pcb-v2", {'UserInterface': {'VisibleElements': ['!RatsNest','!GridPoints']}})
         self.dsn_dir = files('pcbenv.data').joinpath('boards').joinpath('PCBBenchmarks-master')
         self.env.set_task({ "pdes": str(self.dsn_dir.joinpath('bm1').joinpath('bm1.routed.kicad_pcb')), 'load_tracks': False, 'resolution_nm': 200000, 'no_polygons': True, 'state_representation': { 'default': 'track' }, 'fixed_track_params': True, 'min_via_diam': 400, 'min_trace_width': 1, 'min_clearance': 100 })
 
-    def test0_RRR(self):
-        """
-        Test that RRR returns the expected result given a parameter and reroute policy.
-        """
+    def run_rrr(self, incremental, threads=1, window=-1, conflict_driven=False, starts=1, score_overlap_free=True, tidy_iterations=2):
         class Policy:
             """
             RRR policy that just reroutes everything in the order from shortest to longest connection.
@@ -44,8 +43,13 @@ class TestCase(unittest.TestCase):
             'history_cost_increment': 1/32,
             'max_iterations': 64,
             'max_iterations_stagnant': 8,
-            'tidy_iterations': 2,
+            'tidy_iterations': tidy_iterations,
             'randomize_order': False, # we use a policy to determine the order
+            'incremental': incremental,
+            'threads': threads,
+            'conflict_driven': conflict_driven,
+            'starts': starts,
+            'score_overlap_free': score_overlap_free,
             'reward': {
                 'function': 'track_length',
                 'per_unrouted': -5,
@@ -55,14 +59,75 @@ class TestCase(unittest.TestCase):
             },
             'astar_costs': {
                 'wd': 1, # 1 = XY routing is off
-                'dir': 'xy'
+                'dir': 'xy',
+                'window': window
             },
             'py_interface': Policy(cons)
         }))
-        env.run_agent({'nets': ['ADC'+str(i) for i in range(16)] + ['PL'+str(i) for i in range(8)] + ['SCL', 'SDA', 'RXD1', 'TXD1', 'PD7', 'N$2']})
-        rv = env.get_state('stats')
+        env.run_agent({'nets': NETS})
+        return env.get_state('stats')
+
+    def test0_RRR(self):
+        """
+        Test that RRR returns the expected result given a parameter and reroute policy.
+        """
+        rv = self.run_rrr(False)
         self.assertTrue(rv['TimeLine'][2]['Success'])
 
+    def test1_Incremental(self):
+        """
+        Test that RRR still succeeds when it reuses the paths of connections whose costs did not change.
+        """
+        rv = self.run_rrr(True)
+        self.assertTrue(rv['TimeLine'][-1]['Success'])
+        self.assertGreater(rv['ReusedPaths'], 0)
+
+    def test2_Parallel(self):
+        """
+        Test that rerouting connections with disjoint search windows in parallel gives the same results as one by one
+        unless a search had to leave its window.
+        """
+        keys = ['Success', 'RewardSum', 'Iteration', 'TrackLen', 'NumVias']
+        rv1 = self.run_rrr(False, 1, 16)
+        self.tearDown()
+        self.setUp()
+        rv4 = self.run_rrr(False, 4, 16)
+        if rv4['WindowMisses'] == 0:
+            self.assertEqual([[r[k] for k in keys] for r in rv1['TimeLine']], [[r[k] for k in keys] for r in rv4['TimeLine']])
+        else:
+            self.assertTrue(rv4['TimeLine'][-1]['Success'])
+
+    def test3_ConflictDriven(self):
+        """
+        Test that RRR still succeeds when it only reroutes the connections around overlaps after the first iteration.
+        """
+        rv = self.run_rrr(False, conflict_driven=True)
+        self.assertTrue(rv['TimeLine'][-1]['Success'])
+
+    def test4_MultiStart(self):
+        """
+        Test that RRR with several starts on cloned boards succeeds and installs the best start's tracks on the board.
+        Without tidying, the final result is scored on the board and must be that of the best start.
+        """
+        rv = self.run_rrr(False, threads=4, starts=4, tidy_iterations=0)
+        self.assertTrue(rv['TimeLine'][-1]['Success'])
+        self.assertEqual(len(rv['Starts']), 4)
+        best = max(rv['Starts'], key=lambda r: (r['Success'], r['RewardSum']))
+        final = rv['TimeLine'][-1]
+        self.assertEqual(final['Success'], best['Success'])
+        self.assertAlmostEqual(final['RewardSum'], best['RewardSum'], places=3)
+        self.assertEqual(final['TrackLen'], best['TrackLen'])
+        self.assertEqual(final['NumVias'], best['NumVias'])
+        self.assertEqual(final['NumUnrouted'], best['NumUnrouted'])
+
+    def test5_ScoreOverlapFree(self):
+        """
+        Test that RRR still succeeds when it scores overlap-free passes as they are, and that the result is legal.
+        """
+        rv = self.run_rrr(False)
+        self.assertTrue(rv['TimeLine'][-1]['Success'])
+        self.assertEqual(self.env.get_state({'clearance_check': {'nets': NETS}})['clearance_check'], [])
+
     def tearDown(self):
         self.env.close()
 
@@ -9,6 +9,21 @@ from importlib_resources import files
 def grid_ko_route_vias(s):
     return np.bitwise_and(np.flip(s[0], axis=0), 1 << 7).astype(bool).astype(int)
 
+def grid_state(env):
+    """
+    Copy the flags and costs of the whole grid.
+    """
+    view = env.get_state({'grid_view': None})['grid_view']
+    return { 'flags': view['flags'].copy(), 'costs': view['cost'].copy() }
+
+def assert_grid_equal(test, S0, S1):
+    for key in ('flags', 'costs'):
+        test.assertTrue(np.array_equal(S0[key], S1[key]), key)
+
+# Put ADC13 in its own net class so that routing it changes the grid spacings.
+NET_A = ('ADC13',0)
+NET_OVERRIDES = { 'trace_widths_um': [('ADC13', 600)], 'clearances_um': [('ADC13', 400)], 'via_diameters_um': [('ADC13', 1200)] }
+
 class TestCase(unittest.TestCase):
     def setUp(self):
         self.env = pcbenv.make("pcb-v2", {'UserInterface': {'VisibleElements': ['!RatsNest','GridPoints']}})
@@ -76,6 +91,79 @@ class TestCase(unittest.TestCase):
         self.assertTrue((S234_2[1] == S321_2[0]).all())
         args.stay_open()
 
+    def set_task_two_classes(self):
+        """
+        Load the board with ADC13 in a different net class and return a connection of the default class.
+        """
+        env = self.env
+        rv = env.set_task({ 'pdes': str(self.dsn_dir.joinpath('bm1').joinpath('bm1.unrouted.dsn')),
+                            'no_polygons': True,
+                            'resolution_nm': 200000,
+                            'net_overrides': NET_OVERRIDES })
+        self.assertTrue(rv)
+        nets = env.get_state({'board': 3})['board']['nets']
+        B = sorted(name for name, net in nets.items() if name != NET_A[0] and len(net['connections']))[0]
+        return (B,0)
+
+    def switch_classes(self):
+        """
+        Route and unroute under class A so that the grid has to switch back to class B at the end.
+        Returns the grid with both connections routed and then with both unrouted again,
+        where wrong KO counts would leave clearance flags behind.
+        """
+        env = self.env
+        B = self.set_task_two_classes()
+        env.step(('astar', B))
+        env.step(('astar', NET_A))
+        env.step(('unroute', B))
+        env.step(('unroute', NET_A))
+        env.step(('astar', NET_A))
+        env.step(('astar', B))
+        S = grid_state(env)
+        env.step(('unroute', NET_A))
+        env.step(('unroute', B))
+        return S, grid_state(env)
+
+    def test1_SpacingClassCache(self):
+        """
+        Check that switching back to a cached spacing class after routing and unrouting under another one
+        gives the same grid as rasterizing the clearance areas from scratch, also after unrouting.
+        """
+        S1 = self.switch_classes()
+        self.env.close()
+        self.env = pcbenv.make("pcb-v2", {'MaxGridSpacingClasses': 1, 'UserInterface': {'VisibleElements': ['!RatsNest','GridPoints']}})
+        S2 = self.switch_classes()
+        for a, b in zip(S1, S2):
+            assert_grid_equal(self, a, b)
+
+    def test2_SnapshotRestore(self):
+        """
+        Take a grid snapshot, then change the costs and route and unroute under another spacing class.
+        Check that restoring the snapshot gives back the same grid, and that the restored KO counts
+        and cached spacing classes let unrouting return the grid to its state before routing.
+        """
+        env = self.env
+        B = self.set_task_two_classes()
+        env.step(('astar', B))
+        env.step(('unroute', B))
+        E = grid_state(env)
+        env.step(('astar', NET_A))
+        env.step(('unroute', NET_A))
+        env.step(('astar', B))
+        env.step(('grid_snapshot', 'save'))
+        S0 = grid_state(env)
+
+        env.step(('set_costs', (1.5, (0,0,0), (10,10,0))))
+        env.step(('astar', NET_A))
+        env.step(('unroute', NET_A))
+        env.step(('grid_snapshot', 'restore'))
+        S1 = grid_state(env)
+        env.step(('grid_snapshot', 'drop'))
+        assert_grid_equal(self, S0, S1)
+
+        env.step(('unroute', B))
+        assert_grid_equal(self, E, grid_state(env))
+
     def tearDown(self):
         self.env.close()
 
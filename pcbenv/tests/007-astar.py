@@ -0,0 +1,203 @@
+import numpy as np
+import unittest
+import pcbenv.tests.args as args
+import pcbenv
+from pcbenv.util.json_pcb import JsonPCB, Shape
+
+from importlib_resources import files
+
+CONNECTIONS = [("PH4",0), ("PH3",0), ("TXD2",0), ("PE5",0), ("SCL",0), ("SDA",0)]
+
+class TestCase(unittest.TestCase):
+    def setUp(self):
+        self.env = pcbenv.make("pcb-v2", {'UserInterface': {'VisibleElements': ['!RatsNest','!GridPoints']}})
+        self.dsn_dir = files('pcbenv.data').joinpath('boards').joinpath('PCBBenchmarks-master')
+        self.env.set_task({ "pdes": str(self.dsn_dir.joinpath('bm1').joinpath('bm1.routed.kicad_pcb')), 'load_tracks': False, 'resolution_nm': 200000, 'no_polygons': True, 'state_representation': { 'default': 'track' } })
+
+    def route_lengths(self, costs):
+        """
+        Route each connection on its own and return the track lengths.
+        """
+        env = self.env
+        L = []
+        for X in CONNECTIONS:
+            s = env.step(("astar", (X, costs)))[0]
+            L.append(s[0]['length'] if s else None)
+            env.step(("unroute", X))
+        return L
+
+    def route_stats(self, X, costs):
+        """
+        Route a connection on its own and return the tracks and the statistics of the search.
+        """
+        env = self.env
+        s = env.step(("astar", (X, costs)))[0]
+        stats = env.get_state({'astar': None})['astar']
+        env.step(("unroute", X))
+        return s, stats
+
+    def enclose_target(self):
+        """
+        Put a route guard ring on all layers around the component of the target pin of a connection whose source is far away.
+        @return the connection
+        """
+        env = self.env
+        B = JsonPCB(data=env.get_state({'board': 3})['board'])
+        area = B.layout_area_bbox
+        cell = area.w / B.grid_size[0]
+        coms = B.data['components']
+        def com_bbox(pin):
+            for name, C in coms.items():
+                if pin.startswith(name + '-') and pin[len(name)+1:] in C['pins']:
+                    return Shape(C['shape']).bbox()
+            return None
+        for net_name, net in B.data['nets'].items():
+            m = 2 * (net['clearance'] + net['via_diameter']) + 4 * cell
+            for i, X in enumerate(net['connections']):
+                if 'dst_pin' not in X or 'src_pin' not in X:
+                    continue
+                T = com_bbox(X['dst_pin'])
+                S = com_bbox(X['src_pin'])
+                if T is None or S is None:
+                    continue
+                x0, y0, x1, y1 = T.x0 - m, T.y0 - m, T.x1 + m, T.y1 + m
+                if S.x1 + m < x0 or S.x0 - m > x1 or S.y1 + m < y0 or S.y0 - m > y1:
+                    ring = []
+                    for z in range(B.grid_size[2]):
+                        ring += [(x0, y0, z), (x1, y0, z), (x1, y1, z), (x0, y1, z), (x0, y0, z)]
+                    env.step(("set_guard", ring))
+                    return (net_name, i)
+        self.fail("no connection with separate source and target components")
+
+    def test0_JumpPoints(self):
+        """
+        Test that jump point search finds tracks of the same length as the plain search.
+        """
+        L0 = self.route_lengths({})
+        L1 = self.route_lengths({'jps': True})
+        for a, b in zip(L0, L1):
+            self.assertEqual(a is None, b is None)
+            if a is not None:
+                self.assertAlmostEqual(a, b, places=3)
+
+    def test1_IndexedQueue(self):
+        """
+        Test that the indexed open list finds tracks of the same length as the binary heap.
+        """
+        L0 = self.route_lengths({})
+        L1 = self.route_lengths({'queue': 'indexed'})
+        L2 = self.route_lengths({'queue': 'indexed', 'jps': True})
+        for a, b, c in zip(L0, L1, L2):
+            self.assertEqual(a is None, b is None)
+            self.assertEqual(a is None, c is None)
+            if a is not None:
+                self.assertAlmostEqual(a, b, places=3)
+                self.assertAlmostEqual(a, c, places=3)
+        with self.assertRaises(Exception):
+            self.env.step(("astar", (CONNECTIONS[0], {'queue': 'fibonacci'})))
+
+    def test2_Bidirectional(self):
+        """
+        Test that the bidirectional search finds the same connections at the same cost.
+        """
+        for X in CONNECTIONS:
+            s0, stats0 = self.route_stats(X, {})
+            s1, stats1 = self.route_stats(X, {'bidir': True})
+            s2, stats2 = self.route_stats(X, {'bidir': True, 'queue': 'indexed'})
+            self.assertEqual(bool(s0), bool(s1))
+            self.assertEqual(bool(s0), bool(s2))
+            if not s0:
+                continue
+            self.assertAlmostEqual(stats1['cost'], stats0['cost'], delta=stats0['cost'] * 1e-5)
+            self.assertAlmostEqual(stats2['cost'], stats0['cost'], delta=stats0['cost'] * 1e-5)
+
+    def test3_Window(self):
+        """
+        Test that a search window does not prevent finding a path and that a window larger than the board has no effect.
+        """
+        L0 = self.route_lengths({})
+        L1 = self.route_lengths({'window': 0})
+        L2 = self.route_lengths({'window': 1000000})
+        for a, b, c in zip(L0, L1, L2):
+            self.assertEqual(a is None, b is None)
+            self.assertEqual(a, c)
+
+    def test4_Corridor(self):
+        """
+        Test that restricting the search to the corridor of a coarse route still finds all connections,
+        that the paths found in the corridor stay inside it, and that the search falls back to the window if the corridor is blocked.
+        """
+        for X in CONNECTIONS:
+            s0, _ = self.route_stats(X, {})
+            for costs in ({'corridor': 8}, {'corridor': 8, 'window': 16}):
+                s, stats = self.route_stats(X, costs)
+                self.assertEqual(bool(s0), bool(s))
+                self.assertIsNotNone(stats['corridor'])
+                if s and stats['corridor']:
+                    self.assertEqual(stats['outside_corridor'], 0)
+        X = self.enclose_target()
+        s, stats = self.route_stats(X, {'corridor': 8})
+        self.assertFalse(s)
+        self.assertFalse(stats['corridor'])
+
+    def test5_Connectivity(self):
+        """
+        Test that the connectivity check fails a connection with an enclosed target without searching,
+        and that it does not reject connections that can be routed.
+        """
+        X = self.enclose_target()
+        s1, stats1 = self.route_stats(X, {'cc': True})
+        s0, stats0 = self.route_stats(X, {})
+        self.assertFalse(s0)
+        self.assertFalse(s1)
+        self.assertEqual(stats1['visits'], 0)
+        self.assertGreater(stats0['visits'], 0)
+        self.env.step(("set_guard", None))
+
+        L0 = self.route_lengths({})
+        L1 = self.route_lengths({'cc': True})
+        for a, b in zip(L0, L1):
+            self.assertEqual(a is None, b is None)
+            if a is not None:
+                self.assertAlmostEqual(a, b, places=3)
+
+    def test6_NetTree(self):
+        """
+        Test that the connections of the largest net can also be routed when joining the net's existing tracks.
+        """
+        env = self.env
+        B = env.get_state({'board': 3})['board']
+        name, net = max(B['nets'].items(), key=lambda item: len(item[1]['connections']))
+        conns = [(name, i) for i in range(len(net['connections']))]
+        R = []
+        for costs in ({}, {'tree': True}):
+            R.append([bool(env.step(("astar", (X, costs)))[0]) for X in conns])
+            for X in conns:
+                env.step(("unroute", X))
+        self.assertEqual(R[0], R[1])
+
+    def test7_Weighted(self):
+        """
+        Test that the weighted and anytime searches find all connections at no more than the weight times the optimal cost,
+        and that the anytime search's costs never increase.
+        """
+        for X in CONNECTIONS:
+            s0, stats0 = self.route_stats(X, {})
+            s1, stats1 = self.route_stats(X, {'eps': 1.5})
+            s2, stats2 = self.route_stats(X, {'eps': 2, 'anytime': True})
+            self.assertEqual(bool(s0), bool(s1))
+            self.assertEqual(bool(s0), bool(s2))
+            if not s0:
+                continue
+            self.assertLessEqual(stats1['cost'], 1.5 * stats0['cost'] * (1 + 1e-5))
+            self.assertLessEqual(stats2['cost'], 2 * stats0['cost'] * (1 + 1e-5))
+            costs = stats2['costs']
+            self.assertTrue(costs)
+            self.assertTrue(all(b <= a for a, b in zip(costs, costs[1:])))
+            self.assertEqual(stats2['cost'], costs[-1])
+
+    def tearDown(self):
+        self.env.close()
+
+if __name__ == "__main__":
+    unittest.main()